@@ -29,8 +29,10 @@
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/select.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -56,11 +58,28 @@ extern ei_socket_callbacks ei_default_socket_callbacks;
 // Godot-cpp includes
 #include <godot_cpp/classes/class_db_singleton.hpp>
 #include <godot_cpp/classes/engine.hpp>
+#include <godot_cpp/classes/gd_extension_manager.hpp>
 #include <godot_cpp/classes/main_loop.hpp>
 #include <godot_cpp/classes/node.hpp>
 #include <godot_cpp/classes/os.hpp>
+#include <godot_cpp/classes/multi_mesh.hpp>
+#include <godot_cpp/classes/multi_mesh_instance2d.hpp>
+#include <godot_cpp/classes/multi_mesh_instance3d.hpp>
+#include <godot_cpp/classes/navigation_server3d.hpp>
+#include <godot_cpp/classes/node3d.hpp>
+#include <godot_cpp/classes/packed_scene.hpp>
+#include <godot_cpp/classes/physics_direct_space_state3d.hpp>
+#include <godot_cpp/classes/physics_server3d.hpp>
+#include <godot_cpp/classes/project_settings.hpp>
+#include <godot_cpp/classes/physics_ray_query_parameters3d.hpp>
+#include <godot_cpp/classes/rendering_server.hpp>
+#include <godot_cpp/classes/resource_loader.hpp>
+#include <godot_cpp/classes/resource_uid.hpp>
 #include <godot_cpp/classes/scene_tree.hpp>
+#include <godot_cpp/classes/time.hpp>
+#include <godot_cpp/classes/viewport.hpp>
 #include <godot_cpp/classes/window.hpp>
+#include <godot_cpp/classes/world3d.hpp>
 #include <godot_cpp/core/class_db.hpp>
 #include <godot_cpp/core/object.hpp>
 #include <godot_cpp/godot.hpp>
@@ -96,14 +115,18 @@ static Node *get_scene_tree_root(SceneTree *tree) {
 }
 
 /* Find node by path */
-static Node *find_node_by_path(SceneTree *tree, const char *path_str) {
-	if (tree == nullptr || path_str == nullptr)
+static Node *find_node_by_path(SceneTree *tree, const String &path) {
+	if (tree == nullptr)
 		return nullptr;
-	Node *root = tree->get_current_scene();
+	// Absolute paths start at the root window, relative ones at the current scene
+	Node *root = path.is_absolute_path() ? (Node *)tree->get_root() : tree->get_current_scene();
 	if (root == nullptr)
 		return nullptr;
-	NodePath path = NodePath(String::utf8(path_str));
-	return root->get_node_or_null(path);
+	CNodeServer *server = CNodeServer::get_singleton();
+	if (server != nullptr) {
+		return server->find_node_cached(root, path);
+	}
+	return root->get_node_or_null(NodePath(path));
 }
 
 /* Get node name as string */
@@ -114,16 +137,66 @@ static const char *get_node_name(Node *node) {
 	return name.utf8().get_data();
 }
 
-/* Get node by instance ID using godot-cpp */
-static Node *get_node_by_id(int64_t node_id) {
-	if (node_id == 0)
-		return nullptr;
-	// In godot-cpp, we use ObjectDB::get_instance()
-	ObjectID obj_id = ObjectID((uint64_t)node_id);
-	Object *obj = ObjectDB::get_instance(obj_id);
-	if (obj == nullptr)
+// Connection whose request is being handled; selects the handle table used for object IDs
+static int current_request_fd = -1;
+// Monotonic time the request being handled was read off the socket, the start of relative timeouts
+static uint64_t current_request_received_usec = 0;
+// Prefetch spec applied when variant_to_bert encodes an object (connection-wide or per call)
+static const CNodePrefetchSpec *active_prefetch = nullptr;
+
+/* Sets current_request_fd and its prefetch spec for one request (or message encoded outside of one) */
+struct CNodeRequestScope {
+	int saved_fd;
+	const CNodePrefetchSpec *saved_prefetch;
+	explicit CNodeRequestScope(int fd) :
+			saved_fd(current_request_fd), saved_prefetch(active_prefetch) {
+		CNodeServer *server = CNodeServer::get_singleton();
+		current_request_fd = fd;
+		active_prefetch = server != nullptr ? server->get_prefetch(fd) : nullptr;
+	}
+	~CNodeRequestScope() {
+		current_request_fd = saved_fd;
+		active_prefetch = saved_prefetch;
+	}
+};
+
+/* Overrides the prefetch spec while one value is encoded */
+struct CNodePrefetchScope {
+	const CNodePrefetchSpec *saved;
+	explicit CNodePrefetchScope(const CNodePrefetchSpec *spec) :
+			saved(active_prefetch) { active_prefetch = spec; }
+	~CNodePrefetchScope() { active_prefetch = saved; }
+};
+
+/* Helper: Resolve an object ID from the client, a handle in handles mode (anything up to 2^31) */
+static Object *resolve_object_ref(int64_t object_id) {
+	if (object_id == 0) {
 		return nullptr;
-	return Object::cast_to<Node>(obj);
+	}
+	CNodeServer *server = CNodeServer::get_singleton();
+	if (server != nullptr && object_id > 0 && object_id <= CNodeObjectHandles::MAX_HANDLE) {
+		CNodeObjectHandles *handles = server->get_object_handles(current_request_fd);
+		if (handles != nullptr) {
+			return handles->lookup((uint32_t)object_id);
+		}
+	}
+	return ObjectDB::get_instance(ObjectID((uint64_t)object_id));
+}
+
+/* Helper: The ID of an object as sent to the client, a handle in handles mode */
+static int64_t export_object_ref(Object *obj) {
+	if (obj == nullptr) {
+		return 0;
+	}
+	CNodeServer *server = CNodeServer::get_singleton();
+	CNodeObjectHandles *handles = server != nullptr ? server->get_object_handles(current_request_fd) : nullptr;
+	uint32_t handle = handles != nullptr ? handles->get_handle(obj) : 0;
+	return handle != 0 ? (int64_t)handle : (int64_t)obj->get_instance_id();
+}
+
+/* Get node by instance ID (or handle) */
+static Node *get_node_by_id(int64_t node_id) {
+	return Object::cast_to<Node>(resolve_object_ref(node_id));
 }
 
 /* Convert BERT to Variant (decode from ei buffer) */
@@ -158,12 +231,48 @@ static Variant bert_to_variant(char *buf, int *index, bool skip_version = false)
 			}
 			return Variant(String::utf8(atom));
 
+		case ERL_SMALL_INTEGER_EXT:
 		case ERL_INTEGER_EXT:
 			if (ei_decode_long(buf, index, &long_val) == 0) {
 				return Variant((int64_t)long_val);
 			}
 			break;
 
+		case ERL_SMALL_BIG_EXT:
+		case ERL_LARGE_BIG_EXT: {
+			// Instance IDs exceed the 32-bit integer encoding and arrive as bignums
+			long long big_val;
+			if (ei_decode_longlong(buf, index, &big_val) == 0) {
+				return Variant((int64_t)big_val);
+			}
+			ei_skip_term(buf, index);
+			break;
+		}
+
+		case ERL_BINARY_EXT: {
+			// Elixir strings are binaries
+			PackedByteArray bytes;
+			bytes.resize(arity);
+			long bin_len = 0;
+			if (ei_decode_binary(buf, index, bytes.ptrw(), &bin_len) == 0) {
+				return Variant(String::utf8((const char *)bytes.ptr(), (int)bin_len));
+			}
+			break;
+		}
+
+		case ERL_MAP_EXT: {
+			if (ei_decode_map_header(buf, index, &arity) < 0) {
+				return Variant(); // Error
+			}
+			Dictionary dict;
+			for (int i = 0; i < arity; i++) {
+				Variant key = bert_to_variant(buf, index, true); // Skip version, already in map
+				Variant value = bert_to_variant(buf, index, true);
+				dict[key] = value;
+			}
+			return Variant(dict);
+		}
+
 		case ERL_FLOAT_EXT:
 		case NEW_FLOAT_EXT:
 			if (ei_decode_double(buf, index, &double_val) == 0) {
@@ -172,8 +281,17 @@ static Variant bert_to_variant(char *buf, int *index, bool skip_version = false)
 			break;
 
 		case ERL_STRING_EXT:
-			if (ei_decode_string(buf, index, string_buf) == 0) {
-				return Variant(String::utf8(string_buf));
+			if (arity < (int)sizeof(string_buf)) {
+				if (ei_decode_string(buf, index, string_buf) == 0) {
+					return Variant(String::utf8(string_buf));
+				}
+			} else {
+				// Too long for the stack buffer
+				CharString long_buf;
+				long_buf.resize(arity + 1);
+				if (ei_decode_string(buf, index, long_buf.ptrw()) == 0) {
+					return Variant(String::utf8(long_buf.get_data()));
+				}
 			}
 			break;
 
@@ -206,6 +324,7 @@ static Variant bert_to_variant(char *buf, int *index, bool skip_version = false)
 		case ERL_SMALL_TUPLE_EXT:
 		case ERL_LARGE_TUPLE_EXT:
 			if (ei_decode_tuple_header(buf, index, &arity) == 0 && arity > 0) {
+				int elements_index = *index;
 				if (ei_decode_atom(buf, index, atom) == 0) {
 					if (strcmp(atom, "vector2") == 0 && arity == 3) {
 						double x, y;
@@ -237,6 +356,13 @@ static Variant bert_to_variant(char *buf, int *index, bool skip_version = false)
 						return Variant(dict);
 					}
 				}
+				// Untagged tuple - decode the elements as an Array so the following terms stay aligned
+				*index = elements_index;
+				Array elements;
+				for (int i = 0; i < arity; i++) {
+					elements.push_back(bert_to_variant(buf, index, true)); // Skip version, already in tuple
+				}
+				return Variant(elements);
 			}
 			break;
 
@@ -244,6 +370,11 @@ static Variant bert_to_variant(char *buf, int *index, bool skip_version = false)
 			// Empty list [] can be encoded as ERL_NIL_EXT
 			ei_skip_term(buf, index);
 			return Variant(); // Return NIL - caller should handle conversion to empty array if needed
+
+		default:
+			// Pids, references, funs... have no Variant equivalent - skip so the following terms still decode
+			ei_skip_term(buf, index);
+			return Variant();
 	}
 
 	return Variant(); // Error or unsupported type
@@ -334,12 +465,29 @@ static void variant_to_bert(const Variant &var, ei_x_buff *x) {
 			if (obj == nullptr) {
 				ei_x_encode_atom(x, "nil");
 			} else {
-				// Encode object as tuple with type name and instance ID
-				ei_x_encode_tuple_header(x, 3);
+				// Encode object as tuple with type name and instance ID, plus prefetched properties if requested
+				const LocalVector<StringName> *prefetch = nullptr;
+				if (active_prefetch != nullptr) {
+					for (uint32_t i = 0; i < active_prefetch->classes.size() && prefetch == nullptr; i++) {
+						if (obj->is_class(active_prefetch->classes[i])) {
+							prefetch = &active_prefetch->properties[i];
+						}
+					}
+				}
+				ei_x_encode_tuple_header(x, prefetch != nullptr ? 4 : 3);
 				ei_x_encode_atom(x, "object");
 				String class_name = obj->get_class();
 				ei_x_encode_string(x, class_name.utf8().get_data());
-				ei_x_encode_long(x, (int64_t)obj->get_instance_id());
+				ei_x_encode_longlong(x, export_object_ref(obj));
+				if (prefetch != nullptr) {
+					// Objects inside prefetched values stay plain references, which also stops cycles
+					CNodePrefetchScope nested(nullptr);
+					ei_x_encode_map_header(x, prefetch->size());
+					for (uint32_t i = 0; i < prefetch->size(); i++) {
+						ei_x_encode_string(x, String((*prefetch)[i]).utf8().get_data());
+						variant_to_bert(obj->get((*prefetch)[i]), x);
+					}
+				}
 			}
 			break;
 		}
@@ -358,6 +506,8 @@ static void variant_to_bert(const Variant &var, ei_x_buff *x) {
 /* CNode configuration */
 #define MAXBUFLEN 8192
 /* MAXATOMLEN is already defined in ei.h */
+/* Most instances one instantiate call creates; spawn_tree with a batch size spreads more over frames */
+static const int64_t INSTANTIATE_MAX_COUNT = 4096;
 
 /* Global state */
 ei_cnode ec;
@@ -368,10 +518,13 @@ godot_instance_t instances[MAX_INSTANCES];
 int next_instance_id = 1;
 
 /* Forward declarations */
-static int process_message(char *buf, int *index, int fd);
+static int process_message(char *buf, int *index, int fd, uint64_t received_usec = 0);
 static int handle_call(char *buf, int *index, int fd, erlang_pid *from_pid, erlang_ref *tag_ref);
 static int handle_cast(char *buf, int *index);
+static int handle_call_at(char *buf, int *index);
 static void send_reply(ei_x_buff *x, int fd, erlang_pid *to_pid, erlang_ref *tag_ref);
+static int send_message(int fd, erlang_pid *to_pid, ei_x_buff *x);
+static bool decode_pid_arg(char *buf, int args_index, int position, erlang_pid *r_pid);
 
 /* Custom socket callbacks for macOS compatibility */
 /* macOS doesn't support SO_ACCEPTCONN, so we need a custom accept implementation */
@@ -678,8 +831,10 @@ int init_cnode(char *nodename, char *cookie) {
  * - Version (optional)
  * - Tuple header
  * - Tuple elements: {Module, Function, Args} for plain RPC calls
+ *
+ * received_usec is when the message was read off the socket (0 = now), the start of relative timeouts
  */
-static int process_message(char *buf, int *index, int fd) {
+static int process_message(char *buf, int *index, int fd, uint64_t received_usec) {
 	// Guard: Check for null pointers
 	if (buf == nullptr || index == nullptr) {
 		fprintf(stderr, "Error: null pointer in process_message\n");
@@ -692,6 +847,8 @@ static int process_message(char *buf, int *index, int fd) {
 		return -1;
 	}
 
+	CNodeRequestScope scope(fd);
+	current_request_received_usec = received_usec != 0 ? received_usec : Time::get_singleton()->get_ticks_usec();
 	int version;
 	int arity;
 	char atom[MAXATOMLEN];
@@ -834,11 +991,19 @@ static godot_instance_t *get_current_instance() {
 
 /* Helper: Get object by instance ID (generic, not just Node) */
 static Object *get_object_by_id(int64_t object_id) {
-	if (object_id == 0)
-		return nullptr;
-	ObjectID obj_id = ObjectID((uint64_t)object_id);
-	Object *obj = ObjectDB::get_instance(obj_id);
-	return obj;
+	return resolve_object_ref(object_id);
+}
+
+/* Helper: Resolve the target of call_method/get_property/set_property, an ID or a node path */
+static Object *resolve_object_arg(const Variant &target) {
+	switch (target.get_type()) {
+		case Variant::STRING:
+		case Variant::STRING_NAME:
+		case Variant::NODE_PATH:
+			return find_node_by_path(get_scene_tree(), target.operator String());
+		default:
+			return get_object_by_id(target.operator int64_t());
+	}
 }
 
 /* Helper: Execute Godot API call using call_deferred() from background thread */
@@ -935,422 +1100,2171 @@ static void encode_property_info(const Dictionary &property, ei_x_buff *x) {
 	ei_x_encode_string(x, property.get("class_name", "").operator String().utf8().get_data());
 }
 
-/*
- * Handle synchronous call from Erlang/Elixir (GenServer-style with reply)
- */
-static int handle_call(char *buf, int *index, int fd, erlang_pid *from_pid, erlang_ref *tag_ref) {
-	// Guard: Check for null pointers
-	if (buf == nullptr || index == nullptr) {
-		fprintf(stderr, "Error: null pointer in handle_call\n");
-		return -1;
+/* Helper: Resolve a query root - instance ID, node path string, or 0/nil for the current scene */
+static Node *resolve_query_root(const Variant &root) {
+	SceneTree *tree = get_scene_tree();
+	if (root.get_type() == Variant::STRING) {
+		return find_node_by_path(tree, root.operator String());
 	}
-
-	// Guard: Check for valid file descriptor
-	if (fd < 0) {
-		fprintf(stderr, "Error: invalid file descriptor in handle_call\n");
-		return -1;
+	int64_t node_id = root.get_type() == Variant::INT ? root.operator int64_t() : 0;
+	if (node_id == 0) {
+		return get_scene_tree_root(tree);
 	}
+	return get_node_by_id(node_id);
+}
 
-	ei_x_buff reply;
-	godot_instance_t *inst;
-
-	/* Initialize reply buffer */
-	ei_x_new(&reply);
+/* Node filter for query, built once from the client's filter map */
+struct NodeQueryFilter {
+	String class_name; // Matches inherited classes too
+	StringName group;
+	String name_pattern; // Glob, see String::match
+	int max_depth; // -1 = unlimited, 0 = root only
+};
 
-	/* Decode Request: {Module, Function, Args} */
-	int request_arity;
-	if (ei_decode_tuple_header(buf, index, &request_arity) < 0 || request_arity < 2) {
-		printf("Godot CNode: handle_call - Failed to decode Request tuple header (index: %d)\n", *index);
-		fflush(stdout);
-		ei_x_encode_tuple_header(&reply, 2);
-		ei_x_encode_atom(&reply, "error");
-		ei_x_encode_string(&reply, "invalid_request_format");
-		send_reply(&reply, fd, from_pid, tag_ref);
-		ei_x_free(&reply);
-		return -1;
+static NodeQueryFilter parse_query_filter(const Variant &filter_variant) {
+	NodeQueryFilter filter;
+	filter.max_depth = -1;
+	if (filter_variant.get_type() != Variant::DICTIONARY) {
+		return filter;
+	}
+	Dictionary filter_dict = filter_variant.operator Dictionary();
+	if (filter_dict.has("class")) {
+		filter.class_name = filter_dict["class"].operator String();
 	}
+	if (filter_dict.has("group")) {
+		filter.group = StringName(filter_dict["group"].operator String());
+	}
+	if (filter_dict.has("name")) {
+		filter.name_pattern = filter_dict["name"].operator String();
+	}
+	if (filter_dict.has("max_depth")) {
+		filter.max_depth = (int)filter_dict["max_depth"].operator int64_t();
+	}
+	return filter;
+}
 
-	/* Decode Module and Function from Request tuple */
-	char module[256];
-	char function[256];
+static bool node_matches_filter(Node *node, const NodeQueryFilter &filter) {
+	if (!filter.class_name.is_empty() && !node->is_class(filter.class_name)) {
+		return false;
+	}
+	if (!filter.group.is_empty() && !node->is_in_group(filter.group)) {
+		return false;
+	}
+	if (!filter.name_pattern.is_empty() && !String(node->get_name()).match(filter.name_pattern)) {
+		return false;
+	}
+	return true;
+}
 
-	if (ei_decode_atom(buf, index, module) < 0) {
-		printf("Godot CNode: handle_call - Failed to decode Module (index: %d)\n", *index);
-		fflush(stdout);
-		ei_x_encode_tuple_header(&reply, 2);
-		ei_x_encode_atom(&reply, "error");
-		ei_x_encode_string(&reply, "invalid_module");
-		send_reply(&reply, fd, from_pid, tag_ref);
-		ei_x_free(&reply);
-		return -1;
+/* Helper: Walk the subtree under root once (pre-order) and collect nodes matching filter */
+static void collect_query_matches(Node *root, const NodeQueryFilter &filter, LocalVector<Node *> &r_matches) {
+	struct PendingNode {
+		Node *node;
+		int depth;
+	};
+	LocalVector<PendingNode> stack;
+	stack.push_back({ root, 0 });
+	while (!stack.is_empty()) {
+		PendingNode current = stack[stack.size() - 1];
+		stack.resize(stack.size() - 1);
+
+		if (node_matches_filter(current.node, filter)) {
+			r_matches.push_back(current.node);
+		}
+		if (filter.max_depth >= 0 && current.depth >= filter.max_depth) {
+			continue;
+		}
+		// Push children in reverse so they pop in tree order
+		for (int i = current.node->get_child_count() - 1; i >= 0; i--) {
+			stack.push_back({ current.node->get_child(i), current.depth + 1 });
+		}
 	}
+}
 
-	if (ei_decode_atom(buf, index, function) < 0) {
-		printf("Godot CNode: handle_call - Failed to decode Function (index: %d)\n", *index);
-		fflush(stdout);
-		ei_x_encode_tuple_header(&reply, 2);
-		ei_x_encode_atom(&reply, "error");
-		ei_x_encode_string(&reply, "invalid_function");
-		send_reply(&reply, fd, from_pid, tag_ref);
-		ei_x_free(&reply);
-		return -1;
+/* Helper: Convert a list of property names to StringNames once, instead of once per object */
+static LocalVector<StringName> to_property_names(const Variant &fields_variant) {
+	LocalVector<StringName> names;
+	if (fields_variant.get_type() == Variant::ARRAY) {
+		Array fields = fields_variant.operator Array();
+		names.reserve(fields.size());
+		for (int i = 0; i < fields.size(); i++) {
+			names.push_back(StringName(fields[i].operator String()));
+		}
 	}
+	return names;
+}
 
-	printf("Godot CNode: handle_call - Decoded Request: Module=%s, Function=%s, Arity=%d\n", module, function, request_arity);
-	fflush(stdout);
+/* Helper: Build a prefetch spec from #{Class => [Prop, ...]} (or [{Class, [Prop, ...]}] to fix the order) */
+static CNodePrefetchSpec parse_prefetch_spec(const Variant &spec_variant) {
+	CNodePrefetchSpec spec;
+	if (spec_variant.get_type() == Variant::DICTIONARY) {
+		Dictionary classes = spec_variant.operator Dictionary();
+		Array keys = classes.keys();
+		for (int i = 0; i < keys.size(); i++) {
+			spec.classes.push_back(keys[i].operator String());
+			spec.properties.push_back(to_property_names(classes[keys[i]]));
+		}
+	} else if (spec_variant.get_type() == Variant::ARRAY) {
+		Array entries = spec_variant.operator Array();
+		for (int i = 0; i < entries.size(); i++) {
+			if (entries[i].get_type() != Variant::ARRAY || entries[i].operator Array().size() != 2) {
+				continue;
+			}
+			Array entry = entries[i].operator Array();
+			spec.classes.push_back(entry[0].operator String());
+			spec.properties.push_back(to_property_names(entry[1]));
+		}
+	}
+	return spec;
+}
 
-	// Decode arguments (remaining elements in Request tuple)
-	Array args;
-	if (request_arity > 2) {
-		// Decode args array
-		Variant args_variant = bert_to_variant(buf, index, true); // Skip version, already in tuple
-		if (args_variant.get_type() == Variant::ARRAY) {
-			args = args_variant.operator Array();
-			printf("Godot CNode: handle_call - Decoded args array with %lld elements\n", (long long)args.size());
-		} else {
-			// Single argument, wrap in array
-			args.push_back(args_variant);
-			printf("Godot CNode: handle_call - Decoded single arg, wrapped in array\n");
+/*
+ * Helper: Check the options of a {Module, Function, Args, Opts} request against the clock
+ * Opts is #{deadline_ms => T} (absolute, on the CNode's monotonic clock from get_stats) and/or
+ * #{timeout_ms => T} (relative to when the request was read), or the same as a keyword list
+ */
+static bool request_expired(const Variant &opts_variant) {
+	Variant deadline_ms;
+	Variant timeout_ms;
+	if (opts_variant.get_type() == Variant::DICTIONARY) {
+		Dictionary opts = opts_variant.operator Dictionary();
+		deadline_ms = opts.get("deadline_ms", Variant());
+		timeout_ms = opts.get("timeout_ms", Variant());
+	} else if (opts_variant.get_type() == Variant::ARRAY) {
+		Array opts = opts_variant.operator Array();
+		for (int i = 0; i < opts.size(); i++) {
+			if (opts[i].get_type() != Variant::ARRAY || opts[i].operator Array().size() != 2) {
+				continue;
+			}
+			Array opt = opts[i].operator Array();
+			String key = opt[0].operator String();
+			if (key == "deadline_ms") {
+				deadline_ms = opt[1];
+			} else if (key == "timeout_ms") {
+				timeout_ms = opt[1];
+			}
 		}
-		fflush(stdout);
 	}
 
-	// Route based on module
-	if (strcmp(module, "godot") == 0) {
-		// Generic Godot API calls - now safe since we're on main thread
-		if (strcmp(function, "call_method") == 0) {
-			if (args.size() >= 2) {
-				int64_t object_id = args[0].operator int64_t();
-				String method_name = args[1].operator String();
-				Array method_args;
-				if (args.size() > 2 && args[2].get_type() == Variant::ARRAY) {
-					method_args = args[2].operator Array();
-				}
+	uint64_t now = Time::get_singleton()->get_ticks_usec();
+	if (deadline_ms.get_type() == Variant::INT && now >= (uint64_t)MAX((int64_t)0, deadline_ms.operator int64_t()) * 1000) {
+		return true;
+	}
+	if (timeout_ms.get_type() == Variant::INT && now >= current_request_received_usec + (uint64_t)MAX((int64_t)0, timeout_ms.operator int64_t()) * 1000) {
+		return true;
+	}
+	return false;
+}
 
-				// Get object and call method using callv() which supports unlimited arguments
-				Object *obj = ObjectDB::get_instance(ObjectID((uint64_t)object_id));
-				if (obj != nullptr) {
-					Variant result;
-					// Use callv() which accepts an Array of arguments - no limit!
-					result = obj->callv(method_name, method_args);
+/* Helper: Encode query result rows [Id | FieldValues] */
+static void encode_query_rows(const LocalVector<Node *> &nodes, const LocalVector<StringName> &fields, ei_x_buff *x) {
+	ei_x_encode_list_header(x, nodes.size());
+	for (uint32_t i = 0; i < nodes.size(); i++) {
+		ei_x_encode_list_header(x, fields.size() + 1);
+		ei_x_encode_longlong(x, export_object_ref(nodes[i]));
+		for (uint32_t j = 0; j < fields.size(); j++) {
+			variant_to_bert(nodes[i]->get(fields[j]), x);
+		}
+		ei_x_encode_empty_list(x);
+	}
+	ei_x_encode_empty_list(x);
+}
 
-					// Encode result
-					variant_to_bert(result, &reply);
-				} else {
-					ei_x_encode_tuple_header(&reply, 2);
-					ei_x_encode_atom(&reply, "error");
-					ei_x_encode_string(&reply, "object_not_found");
-				}
-			} else {
-				ei_x_encode_tuple_header(&reply, 2);
-				ei_x_encode_atom(&reply, "error");
-				ei_x_encode_string(&reply, "insufficient_arguments");
-			}
-		} else if (strcmp(function, "get_property") == 0) {
-			if (args.size() >= 2) {
-				int64_t object_id = args[0].operator int64_t();
-				String prop_name = args[1].operator String();
+/* Helper: Encode subtree snapshot rows {Id, ParentId, Name, Class, FieldValues} */
+static void encode_snapshot_rows(const LocalVector<Node *> &nodes, const LocalVector<StringName> &fields, ei_x_buff *x) {
+	ei_x_encode_list_header(x, nodes.size());
+	for (uint32_t i = 0; i < nodes.size(); i++) {
+		Node *node = nodes[i];
+		Node *parent = node->get_parent();
+		ei_x_encode_tuple_header(x, 5);
+		ei_x_encode_longlong(x, export_object_ref(node));
+		ei_x_encode_longlong(x, export_object_ref(parent));
+		ei_x_encode_string(x, String(node->get_name()).utf8().get_data());
+		ei_x_encode_string(x, node->get_class().utf8().get_data());
+		ei_x_encode_list_header(x, fields.size());
+		for (uint32_t j = 0; j < fields.size(); j++) {
+			variant_to_bert(node->get(fields[j]), x);
+		}
+		ei_x_encode_empty_list(x);
+	}
+	ei_x_encode_empty_list(x);
+}
 
-				Object *obj = ObjectDB::get_instance(ObjectID((uint64_t)object_id));
-				if (obj != nullptr) {
-					Variant value = obj->get(prop_name);
-					variant_to_bert(value, &reply);
-				} else {
-					ei_x_encode_tuple_header(&reply, 2);
-					ei_x_encode_atom(&reply, "error");
-					ei_x_encode_string(&reply, "object_not_found");
-				}
-			} else {
-				ei_x_encode_tuple_header(&reply, 2);
-				ei_x_encode_atom(&reply, "error");
-				ei_x_encode_string(&reply, "insufficient_arguments");
-			}
-		} else if (strcmp(function, "set_property") == 0) {
-			if (args.size() >= 3) {
-				int64_t object_id = args[0].operator int64_t();
-				String prop_name = args[1].operator String();
-				Variant value = args[2];
+/* Helper: Move `r_index` to the term at `position` in the Args list starting at args_index */
+static bool seek_arg(const char *buf, int args_index, int position, int *r_index) {
+	int index = args_index;
+	int arity;
+	if (ei_decode_list_header(buf, &index, &arity) < 0 || position >= arity) {
+		return false;
+	}
+	for (int i = 0; i < position; i++) {
+		if (ei_skip_term(buf, &index) < 0) {
+			return false;
+		}
+	}
+	*r_index = index;
+	return true;
+}
 
-				Object *obj = ObjectDB::get_instance(ObjectID((uint64_t)object_id));
-				if (obj != nullptr) {
-					obj->set(prop_name, value);
-					ei_x_encode_atom(&reply, "ok");
-				} else {
-					ei_x_encode_tuple_header(&reply, 2);
-					ei_x_encode_atom(&reply, "error");
-					ei_x_encode_string(&reply, "object_not_found");
-				}
-			} else {
-				ei_x_encode_tuple_header(&reply, 2);
-				ei_x_encode_atom(&reply, "error");
-				ei_x_encode_string(&reply, "insufficient_arguments");
+/* Helper: Decode a list term into an Array; lists of integers 0-255 arrive as byte strings and stay integers */
+static Array decode_list_term(char *buf, int *index) {
+	int type, size;
+	if (ei_get_type(buf, index, &type, &size) < 0) {
+		return Array();
+	}
+	if (type == ERL_STRING_EXT) {
+		Array values;
+		CharString bytes;
+		bytes.resize(size + 1);
+		if (ei_decode_string(buf, index, bytes.ptrw()) == 0) {
+			for (int i = 0; i < size; i++) {
+				values.push_back((int64_t)(uint8_t)bytes[i]);
 			}
-		} else {
-			ei_x_encode_tuple_header(&reply, 2);
-			ei_x_encode_atom(&reply, "error");
-			ei_x_encode_string(&reply, "unknown_function");
-		}
-	} else if (strcmp(module, "erlang") == 0) {
-		// Erlang built-in functions
-		if (strcmp(function, "node") == 0) {
-			// {call, erlang, node, []} - return the CNode's name
-			// Reply format: just the node name atom (not wrapped in {reply, ...})
-			ei_x_encode_atom(&reply, ec.thisnodename);
-		} else if (strcmp(function, "nodes") == 0) {
-			// {call, erlang, nodes, []} - return list of connected nodes
-			// Reply format: just the list (not wrapped in {reply, ...})
-			// Return empty list for now (CNode doesn't track connected nodes)
-			ei_x_encode_list_header(&reply, 0);
-			ei_x_encode_empty_list(&reply);
-		} else {
-			// Unknown function in erlang module
-			ei_x_encode_tuple_header(&reply, 2);
-			ei_x_encode_atom(&reply, "error");
-			ei_x_encode_string(&reply, "unknown_function");
 		}
-	} else {
-		// Unknown module
-		ei_x_encode_tuple_header(&reply, 2);
-		ei_x_encode_atom(&reply, "error");
-		ei_x_encode_string(&reply, "unknown_module");
+		return values;
 	}
+	Variant list = bert_to_variant(buf, index, true);
+	return list.get_type() == Variant::ARRAY ? list.operator Array() : Array();
+}
 
-	/* Send GenServer-style reply */
-	send_reply(&reply, fd, from_pid, tag_ref);
-	ei_x_free(&reply);
+/* Helper: Decode the ID list at `position` in Args, where handles below 256 make a byte string */
+static Array decode_id_list_arg(char *buf, int args_index, int position) {
+	int index;
+	if (!seek_arg(buf, args_index, position, &index)) {
+		return Array();
+	}
+	return decode_list_term(buf, &index);
+}
 
-	return 0;
+/* Helper: Decode the Pid at `position` in the Args list starting at args_index */
+static bool decode_pid_arg(char *buf, int args_index, int position, erlang_pid *r_pid) {
+	int index;
+	if (!seek_arg(buf, args_index, position, &index)) {
+		return false;
+	}
+	return ei_decode_pid(buf, &index, r_pid) == 0;
+}
+
+/* Helper: Compare two references, e.g. a GenServer call tag against the one a cancel names */
+static bool same_ref(const erlang_ref &a, const erlang_ref &b) {
+	int words = MIN(a.len, (int)(sizeof(a.n) / sizeof(a.n[0])));
+	return a.len == b.len && a.creation == b.creation && strcmp(a.node, b.node) == 0 &&
+			memcmp(a.n, b.n, sizeof(a.n[0]) * MAX(words, 0)) == 0;
 }
 
 /*
- * Handle asynchronous cast from Erlang/Elixir (GenServer-like cast)
+ * Helper: Decode the binary at `position` in the Args list straight into a float array (one copy)
+ * The binary holds native (little-endian) float32 values
  */
-static int handle_cast(char *buf, int *index) {
-	// Guard: Check for null pointers
-	if (buf == nullptr || index == nullptr) {
-		fprintf(stderr, "Error: null pointer in handle_cast\n");
-		return -1;
+static bool decode_float32_binary_arg(char *buf, int args_index, int position, PackedFloat32Array &r_values) {
+	int index, type, size;
+	if (!seek_arg(buf, args_index, position, &index) || ei_get_type(buf, &index, &type, &size) < 0 ||
+			type != ERL_BINARY_EXT || size % sizeof(float) != 0) {
+		return false;
 	}
+	r_values.resize(size / sizeof(float));
+	long bin_len = 0;
+	return ei_decode_binary(buf, &index, r_values.ptrw(), &bin_len) == 0 && bin_len == size;
+}
 
-	/* Decode Request: {Module, Function, Args} */
-	int request_arity;
-	if (ei_decode_tuple_header(buf, index, &request_arity) < 0 || request_arity < 2) {
-		fprintf(stderr, "Error: invalid request format in gen_cast\n");
-		return -1;
+/* Helper: Decode the binary at args[position] as raw bytes */
+static bool decode_byte_binary_arg(char *buf, int args_index, int position, PackedByteArray &r_bytes) {
+	int index, type, size;
+	if (!seek_arg(buf, args_index, position, &index) || ei_get_type(buf, &index, &type, &size) < 0 || type != ERL_BINARY_EXT) {
+		return false;
 	}
+	r_bytes.resize(size);
+	long bin_len = 0;
+	return ei_decode_binary(buf, &index, r_bytes.ptrw(), &bin_len) == 0 && bin_len == size;
+}
 
-	/* Decode Module and Function from Request tuple */
-	char module[256];
-	char function[256];
-
-	if (ei_decode_atom(buf, index, module) < 0) {
-		fprintf(stderr, "Error decoding module in cast\n");
-		return -1;
+/* Helper: Resolve a World3D from its own ID or the ID of a Node3D/Viewport using it (0 = the root viewport's world) */
+static Ref<World3D> resolve_world_3d(int64_t object_id) {
+	if (object_id == 0) {
+		SceneTree *tree = get_scene_tree();
+		Window *root = tree != nullptr ? tree->get_root() : nullptr;
+		return root != nullptr ? root->find_world_3d() : Ref<World3D>();
 	}
-
-	if (ei_decode_atom(buf, index, function) < 0) {
-		fprintf(stderr, "Error decoding function in cast\n");
-		return -1;
+	Object *obj = get_object_by_id(object_id);
+	if (obj == nullptr) {
+		return Ref<World3D>();
+	}
+	World3D *world = Object::cast_to<World3D>(obj);
+	if (world != nullptr) {
+		return Ref<World3D>(world);
+	}
+	Node3D *node_3d = Object::cast_to<Node3D>(obj);
+	if (node_3d != nullptr) {
+		return node_3d->get_world_3d();
 	}
+	Viewport *viewport = Object::cast_to<Viewport>(obj);
+	if (viewport != nullptr) {
+		return viewport->find_world_3d();
+	}
+	return Ref<World3D>();
+}
 
-	// Decode arguments (remaining elements in Request tuple)
-	Array args;
-	if (request_arity > 2) {
-		// Decode args array
-		Variant args_variant = bert_to_variant(buf, index, true); // Skip version, already in tuple
-		if (args_variant.get_type() == Variant::ARRAY) {
-			args = args_variant.operator Array();
-			printf("Godot CNode: handle_cast - Decoded args array with %lld elements\n", (long long)args.size());
-		} else {
-			// Single argument, wrap in array
-			args.push_back(args_variant);
-			printf("Godot CNode: handle_cast - Decoded single arg, wrapped in array\n");
+/* Helper: Resolve a navigation map from a World3D ID (same forms as resolve_world_3d) or a map RID's ID */
+static RID resolve_navigation_map(int64_t id) {
+	Ref<World3D> world = resolve_world_3d(id);
+	if (world.is_valid()) {
+		return world->get_navigation_map();
+	}
+	TypedArray<RID> maps = NavigationServer3D::get_singleton()->get_maps();
+	for (int64_t i = 0; i < maps.size(); i++) {
+		RID map = maps[i];
+		if (map.get_id() == id) {
+			return map;
 		}
-		fflush(stdout);
 	}
+	return RID();
+}
 
-	// Route based on module (async, no reply)
-	printf("Godot CNode: Processing async message - Module: %s, Function: %s\n", module, function);
-	fflush(stdout);
+/* Packed raycast_batch hit record, one per ray */
+struct RaycastHit {
+	uint32_t hit; // 1 when the ray hit something
+	uint32_t shape; // Shape index within the collider
+	float position[3];
+	float normal[3];
+	uint64_t collider_id;
+};
+static_assert(sizeof(RaycastHit) == 40, "RaycastHit is part of the wire format");
 
-	if (strcmp(module, "erlang") == 0) {
-		if (strcmp(function, "node") == 0) {
-			printf("Godot CNode: Async erlang:node - Node name: %s\n", ec.thisnodename);
-		} else if (strcmp(function, "nodes") == 0) {
-			printf("Godot CNode: Async erlang:nodes - No other connected nodes\n");
-		} else {
-			printf("Godot CNode: Async erlang:%s - Unknown function\n", function);
+/*
+ * Helper: Run every ray (origin xyz, direction xyz as float32) against the space and encode the packed hits
+ * Must run during physics time - the direct space state is only safe to query then
+ */
+static void encode_raycast_batch(PhysicsDirectSpaceState3D *space, const PackedFloat32Array &rays, uint32_t mask, ei_x_buff *x) {
+	int64_t ray_count = rays.size() / 6;
+	PackedByteArray hits;
+	hits.resize(ray_count * sizeof(RaycastHit));
+	RaycastHit *out = (RaycastHit *)hits.ptrw();
+	const float *in = rays.ptr();
+
+	// One parameters object reused for every ray
+	Ref<PhysicsRayQueryParameters3D> params;
+	params.instantiate();
+	params->set_collision_mask(mask);
+
+	for (int64_t i = 0; i < ray_count; i++, in += 6) {
+		Vector3 origin(in[0], in[1], in[2]);
+		params->set_from(origin);
+		params->set_to(origin + Vector3(in[3], in[4], in[5]));
+		Dictionary result = space->intersect_ray(params);
+
+		RaycastHit &hit = out[i];
+		memset(&hit, 0, sizeof(RaycastHit));
+		if (result.is_empty()) {
+			continue;
 		}
-	} else if (strcmp(module, "godot") == 0) {
-		// Generic Godot API calls - now safe since we're on main thread
-		if (strcmp(function, "call_method") == 0) {
-			if (args.size() >= 2) {
-				int64_t object_id = args[0].operator int64_t();
-				String method_name = args[1].operator String();
-				Array method_args;
-				if (args.size() > 2 && args[2].get_type() == Variant::ARRAY) {
-					method_args = args[2].operator Array();
-				}
-
-				// Get object and call method (async, no return value) using callv() - no argument limit!
-				Object *obj = ObjectDB::get_instance(ObjectID((uint64_t)object_id));
-				if (obj != nullptr) {
-					// Use callv() which accepts an Array of arguments - supports unlimited arguments
-					obj->callv(method_name, method_args);
-					printf("Godot CNode: Async godot:call_method - Success (called with %lld args)\n", (long long)method_args.size());
-				} else {
-					printf("Godot CNode: Async godot:call_method - Error: Object not found (ID: %lld)\n", (long long)object_id);
-				}
-			} else {
-				printf("Godot CNode: Async godot:call_method - Error: Insufficient arguments\n");
-			}
-		} else if (strcmp(function, "set_property") == 0) {
-			if (args.size() >= 3) {
-				int64_t object_id = args[0].operator int64_t();
-				String prop_name = args[1].operator String();
-				Variant value = args[2];
+		Vector3 position = result["position"];
+		Vector3 normal = result["normal"];
+		hit.hit = 1;
+		hit.shape = (uint32_t)(int64_t)result["shape"];
+		hit.position[0] = position.x;
+		hit.position[1] = position.y;
+		hit.position[2] = position.z;
+		hit.normal[0] = normal.x;
+		hit.normal[1] = normal.y;
+		hit.normal[2] = normal.z;
+		// A handle on a handles-mode connection, like every other object ID it receives
+		hit.collider_id = (uint64_t)export_object_ref(ObjectDB::get_instance(ObjectID((uint64_t)(int64_t)result["collider_id"])));
+	}
+	ei_x_encode_binary(x, hits.ptr(), hits.size());
+}
 
-				Object *obj = ObjectDB::get_instance(ObjectID((uint64_t)object_id));
-				if (obj != nullptr) {
-					obj->set(prop_name, value);
-					printf("Godot CNode: Async godot:set_property - Success\n");
-				} else {
-					printf("Godot CNode: Async godot:set_property - Error: Object not found (ID: %lld)\n", (long long)object_id);
-				}
-			} else {
-				printf("Godot CNode: Async godot:set_property - Error: Insufficient arguments\n");
-			}
-		} else {
-			printf("Godot CNode: Async godot:%s - Unknown function\n", function);
+/*
+ * Helper: Run navigation queries [from, to) - start xyz, goal xyz (float32), layers (uint32) each -
+ * appending every path's points to r_points and its end offset (in points) to r_offsets
+ */
+static void run_nav_path_queries(const RID &map, const PackedFloat32Array &queries, uint32_t from, uint32_t to, bool optimize, LocalVector<uint32_t> &r_offsets, LocalVector<float> &r_points) {
+	NavigationServer3D *nav = NavigationServer3D::get_singleton();
+	const float *query = queries.ptr() + from * 7;
+	for (uint32_t i = from; i < to; i++, query += 7) {
+		uint32_t layers;
+		memcpy(&layers, &query[6], sizeof(uint32_t));
+		PackedVector3Array path = nav->map_get_path(map, Vector3(query[0], query[1], query[2]), Vector3(query[3], query[4], query[5]), optimize, layers);
+		const Vector3 *points = path.ptr();
+		for (int64_t j = 0; j < path.size(); j++) {
+			r_points.push_back(points[j].x);
+			r_points.push_back(points[j].y);
+			r_points.push_back(points[j].z);
 		}
-	} else {
-		printf("Godot CNode: Async %s:%s - Unknown module\n", module, function);
+		r_offsets.push_back(r_points.size() / 3);
 	}
-
-	printf("Godot CNode: Async message processing complete\n");
-	fflush(stdout);
-	return 0;
 }
 
 /*
- * Send reply to Erlang/Elixir (GenServer-style synchronous call)
- * Sends reply in format: {Tag, Reply} to the From PID
+ * Helper: Encode navigation paths as one binary:
+ * uint32 count, uint32 offsets[count + 1] (in points, offsets[0] = 0), float32 xyz points
  */
-static void send_reply(ei_x_buff *x, int fd, erlang_pid *to_pid, erlang_ref *tag_ref) {
-	// Guard: Check for null pointer
-	if (x == nullptr) {
-		fprintf(stderr, "Error: null reply buffer in send_reply\n");
-		return;
+static void encode_nav_paths(const LocalVector<uint32_t> &offsets, const LocalVector<float> &points, ei_x_buff *x) {
+	uint32_t count = offsets.size();
+	PackedByteArray packed;
+	packed.resize(sizeof(uint32_t) * (count + 2) + sizeof(float) * points.size());
+	uint8_t *out = packed.ptrw();
+	uint32_t first_offset = 0;
+	memcpy(out, &count, sizeof(uint32_t));
+	memcpy(out + sizeof(uint32_t), &first_offset, sizeof(uint32_t));
+	if (count > 0) {
+		memcpy(out + sizeof(uint32_t) * 2, offsets.ptr(), sizeof(uint32_t) * count);
 	}
-
-	// Guard: Check for valid file descriptor
-	if (fd < 0) {
-		fprintf(stderr, "Error: invalid file descriptor in send_reply\n");
-		return;
+	if (points.size() > 0) {
+		memcpy(out + sizeof(uint32_t) * (count + 2), points.ptr(), sizeof(float) * points.size());
 	}
+	ei_x_encode_binary(x, packed.ptr(), packed.size());
+}
 
-	// Guard: Check for valid PID and tag
-	if (to_pid == nullptr || tag_ref == nullptr) {
-		fprintf(stderr, "Error: null PID or tag in send_reply\n");
-		return;
+/* Helper: Resolve a MultiMesh from its own ID or the ID of a MultiMeshInstance3D/2D */
+static MultiMesh *resolve_multimesh(int64_t object_id) {
+	Object *obj = get_object_by_id(object_id);
+	if (obj == nullptr) {
+		return nullptr;
+	}
+	MultiMesh *multimesh = Object::cast_to<MultiMesh>(obj);
+	if (multimesh != nullptr) {
+		return multimesh;
 	}
+	MultiMeshInstance3D *instance_3d = Object::cast_to<MultiMeshInstance3D>(obj);
+	if (instance_3d != nullptr) {
+		return instance_3d->get_multimesh().ptr();
+	}
+	MultiMeshInstance2D *instance_2d = Object::cast_to<MultiMeshInstance2D>(obj);
+	if (instance_2d != nullptr) {
+		return instance_2d->get_multimesh().ptr();
+	}
+	return nullptr;
+}
 
-	/* Encode GenServer-style reply: {Tag, Reply} */
-	/* The reply buffer (x) already contains the reply data, we need to wrap it with the tag */
-	ei_x_buff gen_reply;
-	/* Use ei_x_new_with_version to ensure BERT version byte (0x83) is included */
-	/* This is required for ei_send to work correctly */
-	ei_x_new_with_version(&gen_reply);
+/* Helper: Floats per instance in the RenderingServer::multimesh_set_buffer layout */
+static int multimesh_stride(MultiMesh *multimesh) {
+	int stride = multimesh->get_transform_format() == MultiMesh::TRANSFORM_3D ? 12 : 8;
+	if (multimesh->is_using_colors()) {
+		stride += 4;
+	}
+	if (multimesh->is_using_custom_data()) {
+		stride += 4;
+	}
+	return stride;
+}
 
-	/* Encode tuple header for {Tag, Reply} */
-	ei_x_encode_tuple_header(&gen_reply, 2);
+/* Packed rid_set_transforms record: handle, then a Transform3D in multimesh_set_buffer order */
+struct RidTransformRecord {
+	uint32_t handle;
+	float xform[12]; // basis row 0, origin.x, basis row 1, origin.y, basis row 2, origin.z
+};
+static_assert(sizeof(RidTransformRecord) == 52, "RidTransformRecord is part of the wire format");
+
+/* Helper: Apply packed RID transforms, returns how many handles were valid */
+static int apply_rid_transforms(CNodeServer *server, int fd, const PackedByteArray &records) {
+	int applied = 0;
+	int64_t count = records.size() / sizeof(RidTransformRecord);
+	for (int64_t i = 0; i < count; i++) {
+		RidTransformRecord record;
+		memcpy(&record, records.ptr() + i * sizeof(RidTransformRecord), sizeof(RidTransformRecord));
+		const float *m = record.xform;
+		Transform3D transform(m[0], m[1], m[2], m[4], m[5], m[6], m[8], m[9], m[10], m[3], m[7], m[11]);
+		if (server->set_rid_transform(fd, record.handle, transform)) {
+			applied++;
+		}
+	}
+	return applied;
+}
 
-	/* Encode the tag (reference) */
-	ei_x_encode_ref(&gen_reply, tag_ref);
+/* Helper: Free packed uint32 RID handles, returns how many were valid */
+static int free_rid_handles(CNodeServer *server, int fd, const PackedByteArray &handles) {
+	int freed = 0;
+	int64_t count = handles.size() / sizeof(uint32_t);
+	for (int64_t i = 0; i < count; i++) {
+		uint32_t handle;
+		memcpy(&handle, handles.ptr() + i * sizeof(uint32_t), sizeof(uint32_t));
+		if (server->free_rid_handle(fd, handle)) {
+			freed++;
+		}
+	}
+	return freed;
+}
 
-	/* Append the reply data (which is already encoded in x) */
-	/* Note: x->buff may or may not have version byte, but we're appending the encoded data */
-	ei_x_append_buf(&gen_reply, x->buff, x->index);
+/* Helper: Encode {ok, HandlesBinary} with one uint32 per handle */
+static void encode_rid_handles(const LocalVector<uint32_t> &handles, ei_x_buff *x) {
+	ei_x_encode_tuple_header(x, 2);
+	ei_x_encode_atom(x, "ok");
+	ei_x_encode_binary(x, handles.ptr(), handles.size() * sizeof(uint32_t));
+}
 
-	/* Debug: Print hex dump of reply buffer */
-	printf("Godot CNode: Reply buffer (hex, first 64 bytes): ");
-	for (int i = 0; i < gen_reply.index && i < 64; i++) {
-		printf("%02x ", (unsigned char)gen_reply.buff[i]);
+/* Helper: Run every cast in the list at args[position], returns how many failed */
+static int run_cast_list_arg(char *buf, int args_index, int position) {
+	int index, arity;
+	if (!seek_arg(buf, args_index, position, &index) || ei_decode_list_header(buf, &index, &arity) < 0) {
+		return 0;
 	}
-	printf("\n");
-	fflush(stdout);
+	int failed = 0;
+	for (int i = 0; i < arity; i++) {
+		int op_index = index;
+		if (ei_skip_term(buf, &index) < 0) {
+			return failed + arity - i;
+		}
+		if (handle_cast(buf, &op_index) < 0) {
+			failed++;
+		}
+	}
+	return failed;
+}
 
-	/* Send the GenServer-style reply to the From PID */
-	/* Use ei_send to send to a specific PID on the connected socket */
-	/* Format: ei_send(fd, pid, buf, len) */
-	/* Note: ei_send handles the distribution protocol automatically, but the buffer should be a valid BERT term */
-	/* The buffer should start with BERT version byte (0x83) which ei_x_new_with_version adds */
-	int send_result = ei_send(fd, to_pid, gen_reply.buff, gen_reply.index);
-	if (send_result < 0) {
-		fprintf(stderr, "Error sending reply (errno: %d, %s)\n", errno, strerror(errno));
-		fflush(stderr);
-	} else {
-		printf("Godot CNode: Reply sent successfully (GenServer format, %d bytes)\n", gen_reply.index);
-		/* Flush the socket to ensure reply is sent immediately */
-		fflush(stdout);
-		/* Give the socket more time to send the data and for client to receive */
-		usleep(100000); // 100ms - increased from 10ms
+/* Helper: Encode the rows of a lockstep state reply */
+static void encode_step_state(const LocalVector<ObjectID> &ids, const LocalVector<StringName> &fields, ei_x_buff *x) {
+	LocalVector<Node *> nodes;
+	for (uint32_t i = 0; i < ids.size(); i++) {
+		Node *node = Object::cast_to<Node>(ObjectDB::get_instance(ids[i]));
+		if (node != nullptr) {
+			nodes.push_back(node);
+		}
 	}
+	encode_query_rows(nodes, fields, x);
+}
 
-	ei_x_free(&gen_reply);
+/* Helper: Combine the types seen in one get_properties column; NIL means mixed */
+static Variant::Type merge_column_type(Variant::Type column, Variant::Type value) {
+	if (column == Variant::VARIANT_MAX || column == value) {
+		return value;
+	}
+	if ((column == Variant::INT && value == Variant::FLOAT) || (column == Variant::FLOAT && value == Variant::INT)) {
+		return Variant::FLOAT;
+	}
+	return Variant::NIL;
 }
 
 /*
- * Main loop - listen for messages from Erlang/Elixir
+ * Helper: Encode {ok, Columns, Missing} for get_properties
+ * Each column is {f64, Binary}, {i64, Binary} or {vec3, Binary} (little-endian, float32 xyz for
+ * vec3, one value per object) when every object yields that type, otherwise a plain list.
+ * Missing holds the row indices of objects that were not found; their values are NaN, 0 or nil.
  */
-extern "C" {
-void main_loop() {
-	ei_x_buff x;
-	erlang_msg msg;
-	int fd;
-	int res;
-
-	printf("Godot CNode: Entering main loop\n");
+static void encode_property_columns(CNodeServer *server, const LocalVector<Object *> &objects, const LocalVector<StringName> &fields, ei_x_buff *x) {
+	uint32_t rows = objects.size();
+	uint32_t cols = fields.size();
+	LocalVector<Variant> values;
+	values.resize(rows * cols);
+	LocalVector<Variant::Type> column_types;
+	column_types.resize(cols);
+	for (uint32_t c = 0; c < cols; c++) {
+		column_types[c] = Variant::VARIANT_MAX;
+	}
 
-	ei_x_new(&x);
+	// One pass over the objects; consecutive objects of one class share the type lookup
+	String last_class;
+	const HashMap<StringName, Variant::Type> *declared = nullptr;
+	for (uint32_t r = 0; r < rows; r++) {
+		Object *obj = objects[r];
+		if (obj == nullptr) {
+			continue;
+		}
+		String class_name = obj->get_class();
+		if (declared == nullptr || class_name != last_class) {
+			declared = &server->get_class_property_types(class_name);
+			last_class = class_name;
+		}
+		for (uint32_t c = 0; c < cols; c++) {
+			Variant &value = values[r * cols + c];
+			value = obj->get(fields[c]);
+			const Variant::Type *type = declared->getptr(fields[c]);
+			if (type != nullptr && *type != Variant::NIL) {
+				column_types[c] = merge_column_type(column_types[c], *type);
+			} else if (value.get_type() != Variant::NIL) {
+				column_types[c] = merge_column_type(column_types[c], value.get_type());
+			}
+		}
+	}
 
-	/* Check if listen_fd is valid before entering loop */
-	if (listen_fd < 0) {
-		fprintf(stderr, "Godot CNode: Invalid listen_fd: %d, cannot accept connections\n", listen_fd);
-		return;
+	ei_x_encode_tuple_header(x, 3);
+	ei_x_encode_atom(x, "ok");
+	ei_x_encode_list_header(x, cols);
+	for (uint32_t c = 0; c < cols; c++) {
+		if (column_types[c] == Variant::FLOAT) {
+			LocalVector<double> packed;
+			packed.resize(rows);
+			for (uint32_t r = 0; r < rows; r++) {
+				const Variant &value = values[r * cols + c];
+				packed[r] = value.get_type() == Variant::NIL ? NAN : value.operator double();
+			}
+			ei_x_encode_tuple_header(x, 2);
+			ei_x_encode_atom(x, "f64");
+			ei_x_encode_binary(x, packed.ptr(), rows * sizeof(double));
+		} else if (column_types[c] == Variant::VECTOR3) {
+			LocalVector<float> packed;
+			packed.resize(rows * 3);
+			for (uint32_t r = 0; r < rows; r++) {
+				const Variant &value = values[r * cols + c];
+				Vector3 v = value.get_type() == Variant::VECTOR3 ? value.operator Vector3() : Vector3(NAN, NAN, NAN);
+				packed[r * 3] = v.x;
+				packed[r * 3 + 1] = v.y;
+				packed[r * 3 + 2] = v.z;
+			}
+			ei_x_encode_tuple_header(x, 2);
+			ei_x_encode_atom(x, "vec3");
+			ei_x_encode_binary(x, packed.ptr(), rows * 3 * sizeof(float));
+		} else if (column_types[c] == Variant::INT) {
+			LocalVector<int64_t> packed;
+			packed.resize(rows);
+			for (uint32_t r = 0; r < rows; r++) {
+				const Variant &value = values[r * cols + c];
+				packed[r] = value.get_type() == Variant::NIL ? 0 : value.operator int64_t();
+			}
+			ei_x_encode_tuple_header(x, 2);
+			ei_x_encode_atom(x, "i64");
+			ei_x_encode_binary(x, packed.ptr(), rows * sizeof(int64_t));
+		} else {
+			ei_x_encode_list_header(x, rows);
+			for (uint32_t r = 0; r < rows; r++) {
+				variant_to_bert(values[r * cols + c], x);
+			}
+			ei_x_encode_empty_list(x);
+		}
 	}
+	ei_x_encode_empty_list(x);
 
-	while (1) {
-		/* Check if listen_fd is still valid (might be closed during shutdown) */
-		if (listen_fd < 0) {
-			printf("Godot CNode: listen_fd closed, exiting main loop\n");
-			break;
+	uint32_t missing = 0;
+	for (uint32_t r = 0; r < rows; r++) {
+		if (objects[r] == nullptr) {
+			missing++;
 		}
+	}
+	ei_x_encode_list_header(x, missing);
+	for (uint32_t r = 0; r < rows; r++) {
+		if (objects[r] == nullptr) {
+			ei_x_encode_ulong(x, r);
+		}
+	}
+	ei_x_encode_empty_list(x);
+}
 
-		/* Accept connection from Erlang/Elixir node */
-		/* Use blocking ei_accept - this is the standard way for CNode servers */
-		/* ei_accept() handles the Erlang distribution protocol handshake automatically */
-		/* Custom socket callbacks provide macOS-compatible accept implementation */
+/* One {Prop, Column} of set_properties */
+struct PropertyColumn {
+	enum Kind {
+		KIND_F64,
+		KIND_I64,
+		KIND_VEC3, // 3 x float32 per object
+		KIND_LIST,
+	};
+	StringName name;
+	Kind kind;
+	PackedByteArray packed;
+	Array list;
+};
 
-		/* Use select() to wait for connection */
-		fd_set read_fds;
-		FD_ZERO(&read_fds);
-		FD_SET(listen_fd, &read_fds);
-		select(listen_fd + 1, &read_fds, NULL, NULL, NULL);
+/*
+ * Helper: Decode the [{Prop, Column}, ...] list at args[position] for set_properties
+ * Packed columns are read straight from their binaries, every column must have `rows` values
+ */
+static bool parse_property_columns(char *buf, int args_index, int position, int64_t rows, LocalVector<PropertyColumn> &r_columns) {
+	int index, arity;
+	if (!seek_arg(buf, args_index, position, &index) || ei_decode_list_header(buf, &index, &arity) < 0) {
+		return false;
+	}
+	r_columns.resize(arity);
+	for (int i = 0; i < arity; i++) {
+		PropertyColumn &column = r_columns[i];
+		int tuple_arity, type, size;
+		if (ei_decode_tuple_header(buf, &index, &tuple_arity) < 0 || tuple_arity != 2) {
+			return false;
+		}
+		column.name = StringName(bert_to_variant(buf, &index, true).operator String());
 
-		if (!FD_ISSET(listen_fd, &read_fds)) {
+		if (ei_get_type(buf, &index, &type, &size) < 0) {
+			return false;
+		}
+		if (type == ERL_LIST_EXT || type == ERL_NIL_EXT || type == ERL_STRING_EXT) {
+			column.kind = PropertyColumn::KIND_LIST;
+			column.list = decode_list_term(buf, &index);
+			if (column.list.size() != rows) {
+				return false;
+			}
 			continue;
 		}
 
-		ErlConnect con;
-		fd = ei_accept(&ec, listen_fd, &con);
-
-		if (fd < 0) {
-			int saved_errno = errno;
-			fprintf(stderr, "Godot CNode: ei_accept() failed: %d (errno: %d, %s)\n", fd, saved_errno, strerror(saved_errno));
+		char kind[MAXATOMLEN];
+		if (ei_decode_tuple_header(buf, &index, &tuple_arity) < 0 || tuple_arity != 2 || ei_decode_atom(buf, &index, kind) < 0 ||
+				ei_get_type(buf, &index, &type, &size) < 0 || type != ERL_BINARY_EXT) {
+			return false;
+		}
+		int64_t stride;
+		if (strcmp(kind, "f64") == 0) {
+			column.kind = PropertyColumn::KIND_F64;
+			stride = sizeof(double);
+		} else if (strcmp(kind, "i64") == 0) {
+			column.kind = PropertyColumn::KIND_I64;
+			stride = sizeof(int64_t);
+		} else if (strcmp(kind, "vec3") == 0) {
+			column.kind = PropertyColumn::KIND_VEC3;
+			stride = 3 * sizeof(float);
+		} else {
+			return false;
+		}
+		long bin_len = 0;
+		column.packed.resize(size);
+		if (size != rows * stride || ei_decode_binary(buf, &index, column.packed.ptrw(), &bin_len) < 0) {
+			return false;
+		}
+	}
+	return true;
+}
 
-			/* Handle specific error codes */
-			if (saved_errno == EBADF || saved_errno == 9) {
+/* Helper: Apply set_properties columns, returns how many objects were found */
+static int apply_property_columns(const Array &ids, const LocalVector<PropertyColumn> &columns) {
+	int applied = 0;
+	for (int64_t r = 0; r < ids.size(); r++) {
+		Object *obj = resolve_object_arg(ids[r]);
+		if (obj == nullptr) {
+			continue;
+		}
+		for (uint32_t c = 0; c < columns.size(); c++) {
+			const PropertyColumn &column = columns[c];
+			switch (column.kind) {
+				case PropertyColumn::KIND_F64: {
+					double value;
+					memcpy(&value, column.packed.ptr() + r * sizeof(double), sizeof(double));
+					obj->set(column.name, value);
+				} break;
+				case PropertyColumn::KIND_I64: {
+					int64_t value;
+					memcpy(&value, column.packed.ptr() + r * sizeof(int64_t), sizeof(int64_t));
+					obj->set(column.name, value);
+				} break;
+				case PropertyColumn::KIND_VEC3: {
+					float xyz[3];
+					memcpy(xyz, column.packed.ptr() + r * sizeof(xyz), sizeof(xyz));
+					obj->set(column.name, Vector3(xyz[0], xyz[1], xyz[2]));
+				} break;
+				case PropertyColumn::KIND_LIST:
+					obj->set(column.name, column.list[r]);
+					break;
+			}
+		}
+		applied++;
+	}
+	return applied;
+}
+
+/*
+ * Helper: Flatten a spawn spec {ClassOrScenePath, Props, Children} into pre-order entries
+ * Each entry records the index of its parent entry (-1 = attach to the spawn target)
+ */
+static bool parse_spawn_spec(char *buf, int *index, int parent, LocalVector<CNodeSpawnEntry> &r_entries) {
+	int arity;
+	if (ei_decode_tuple_header(buf, index, &arity) < 0 || arity < 1 || arity > 3) {
+		return false;
+	}
+
+	CNodeSpawnEntry entry;
+	entry.type = bert_to_variant(buf, index, true).operator String();
+	entry.parent = parent;
+	if (arity > 1) {
+		Variant props = bert_to_variant(buf, index, true);
+		if (props.get_type() == Variant::DICTIONARY) {
+			entry.props = props.operator Dictionary();
+		}
+	}
+	if (entry.type.is_empty()) {
+		return false;
+	}
+	int self_index = (int)r_entries.size();
+	r_entries.push_back(entry);
+
+	if (arity > 2) {
+		int type, size, children;
+		ei_get_type(buf, index, &type, &size);
+		if (type == ERL_NIL_EXT) {
+			ei_skip_term(buf, index);
+		} else if (ei_decode_list_header(buf, index, &children) == 0) {
+			for (int i = 0; i < children; i++) {
+				if (!parse_spawn_spec(buf, index, self_index, r_entries)) {
+					return false;
+				}
+			}
+			ei_skip_term(buf, index); // List tail
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Helper: Create one spawn entry - a ClassDB class name or a PackedScene path - and apply its properties */
+static Node *instantiate_spawn_entry(const CNodeSpawnEntry &entry) {
+	Node *node = nullptr;
+	CNodeServer *server = CNodeServer::get_singleton();
+	if (entry.type.begins_with("res://") || entry.type.begins_with("uid://")) {
+		if (server != nullptr) {
+			node = server->acquire_scene_instance(entry.type);
+		}
+	} else if (ClassDB::class_exists(entry.type)) {
+		Variant instance = ClassDBSingleton::get_singleton()->instantiate(entry.type);
+		Object *obj = instance.operator Object *();
+		node = Object::cast_to<Node>(obj);
+		if (node == nullptr && obj != nullptr && !obj->is_class("RefCounted")) {
+			memdelete(obj); // Not a Node
+		}
+	}
+	if (node == nullptr) {
+		return nullptr;
+	}
+
+	Array keys = entry.props.keys();
+	for (int i = 0; i < keys.size(); i++) {
+		node->set(StringName(keys[i].operator String()), entry.props[keys[i]]);
+	}
+	return node;
+}
+
+/*
+ * Helper: Instantiate spawn entries [from, to) and attach each to its parent
+ * r_ids holds one ID per entry (null when creation failed - its children are skipped too)
+ * attach_roots = false leaves top-level entries detached so the caller can add them in one go
+ */
+static void spawn_entries(const LocalVector<CNodeSpawnEntry> &entries, uint32_t from, uint32_t to, Node *target, bool attach_roots, LocalVector<ObjectID> &r_ids) {
+	for (uint32_t i = from; i < to; i++) {
+		const CNodeSpawnEntry &entry = entries[i];
+		// Parents are looked up by ID: multi-frame jobs must survive nodes freed between batches
+		Node *parent = entry.parent < 0 ? target : Object::cast_to<Node>(ObjectDB::get_instance(r_ids[entry.parent]));
+		Node *node = (parent != nullptr) ? instantiate_spawn_entry(entry) : nullptr;
+		r_ids.push_back(ObjectID(node != nullptr ? node->get_instance_id() : (uint64_t)0));
+		if (node != nullptr && (entry.parent >= 0 || attach_roots)) {
+			parent->add_child(node);
+		}
+	}
+}
+
+/* Helper: Encode spawned node IDs in spec order (0 for entries that failed) */
+static void encode_spawned_ids(const LocalVector<ObjectID> &ids, ei_x_buff *x) {
+	ei_x_encode_list_header(x, ids.size());
+	for (uint32_t i = 0; i < ids.size(); i++) {
+		ei_x_encode_longlong(x, export_object_ref(ObjectDB::get_instance(ids[i])));
+	}
+	ei_x_encode_empty_list(x);
+}
+
+/*
+ * Handle synchronous call from Erlang/Elixir (GenServer-style with reply)
+ */
+static int handle_call(char *buf, int *index, int fd, erlang_pid *from_pid, erlang_ref *tag_ref) {
+	// Guard: Check for null pointers
+	if (buf == nullptr || index == nullptr) {
+		fprintf(stderr, "Error: null pointer in handle_call\n");
+		return -1;
+	}
+
+	// Guard: Check for valid file descriptor
+	if (fd < 0) {
+		fprintf(stderr, "Error: invalid file descriptor in handle_call\n");
+		return -1;
+	}
+
+	ei_x_buff reply;
+	godot_instance_t *inst;
+	int request_index = *index; // Start of the encoded Request, for calls that re-run later
+
+	/* Initialize reply buffer */
+	ei_x_new(&reply);
+
+	/* Decode Request: {Module, Function, Args} */
+	int request_arity;
+	if (ei_decode_tuple_header(buf, index, &request_arity) < 0 || request_arity < 2) {
+		printf("Godot CNode: handle_call - Failed to decode Request tuple header (index: %d)\n", *index);
+		fflush(stdout);
+		ei_x_encode_tuple_header(&reply, 2);
+		ei_x_encode_atom(&reply, "error");
+		ei_x_encode_string(&reply, "invalid_request_format");
+		send_reply(&reply, fd, from_pid, tag_ref);
+		ei_x_free(&reply);
+		return -1;
+	}
+
+	/* Decode Module and Function from Request tuple */
+	char module[256];
+	char function[256];
+
+	if (ei_decode_atom(buf, index, module) < 0) {
+		printf("Godot CNode: handle_call - Failed to decode Module (index: %d)\n", *index);
+		fflush(stdout);
+		ei_x_encode_tuple_header(&reply, 2);
+		ei_x_encode_atom(&reply, "error");
+		ei_x_encode_string(&reply, "invalid_module");
+		send_reply(&reply, fd, from_pid, tag_ref);
+		ei_x_free(&reply);
+		return -1;
+	}
+
+	if (ei_decode_atom(buf, index, function) < 0) {
+		printf("Godot CNode: handle_call - Failed to decode Function (index: %d)\n", *index);
+		fflush(stdout);
+		ei_x_encode_tuple_header(&reply, 2);
+		ei_x_encode_atom(&reply, "error");
+		ei_x_encode_string(&reply, "invalid_function");
+		send_reply(&reply, fd, from_pid, tag_ref);
+		ei_x_free(&reply);
+		return -1;
+	}
+
+	printf("Godot CNode: handle_call - Decoded Request: Module=%s, Function=%s, Arity=%d\n", module, function, request_arity);
+	fflush(stdout);
+
+	// Decode arguments (remaining elements in Request tuple)
+	// args_index keeps the raw Args position for handlers that take terms with no Variant equivalent (pids)
+	Array args;
+	int args_index = *index;
+	if (request_arity > 2) {
+		// Decode args array
+		Variant args_variant = bert_to_variant(buf, index, true); // Skip version, already in tuple
+		if (args_variant.get_type() == Variant::ARRAY) {
+			args = args_variant.operator Array();
+			printf("Godot CNode: handle_call - Decoded args array with %lld elements\n", (long long)args.size());
+		} else {
+			// Single argument, wrap in array
+			args.push_back(args_variant);
+			printf("Godot CNode: handle_call - Decoded single arg, wrapped in array\n");
+		}
+		fflush(stdout);
+	}
+
+	// Callers past their deadline have given up, so skip the work and only tell them
+	if (request_arity > 3 && request_expired(bert_to_variant(buf, index, true))) {
+		CNodeServer *server = CNodeServer::get_singleton();
+		if (server != nullptr) {
+			server->count_expired_request(true);
+		}
+		ei_x_encode_tuple_header(&reply, 2);
+		ei_x_encode_atom(&reply, "error");
+		ei_x_encode_string(&reply, "expired");
+		send_reply(&reply, fd, from_pid, tag_ref);
+		ei_x_free(&reply);
+		return 0;
+	}
+
+	// A caller that does not read its replies gets no more work done until it catches up
+	CNodeServer *overload_server = CNodeServer::get_singleton();
+	if (overload_server != nullptr && overload_server->get_scheduler().is_outbound_full(fd)) {
+		overload_server->count_overloaded_call();
+		ei_x_encode_tuple_header(&reply, 2);
+		ei_x_encode_atom(&reply, "error");
+		ei_x_encode_string(&reply, "overloaded");
+		send_reply(&reply, fd, from_pid, tag_ref);
+		ei_x_free(&reply);
+		return 0;
+	}
+
+	// Route based on module
+	if (strcmp(module, "godot") == 0) {
+		// Generic Godot API calls - now safe since we're on main thread
+		if (strcmp(function, "call_method") == 0) {
+			if (args.size() >= 2) {
+				String method_name = args[1].operator String();
+				Array method_args;
+				if (args.size() > 2 && args[2].get_type() == Variant::ARRAY) {
+					method_args = args[2].operator Array();
+				}
+
+				// Get object and call method using callv() which supports unlimited arguments
+				Object *obj = resolve_object_arg(args[0]);
+				if (obj != nullptr) {
+					Variant result;
+					// Use callv() which accepts an Array of arguments - no limit!
+					result = obj->callv(method_name, method_args);
+
+					// Encode result, an optional 4th argument overrides the connection's prefetch spec
+					if (args.size() > 3) {
+						CNodePrefetchSpec spec = parse_prefetch_spec(args[3]);
+						CNodePrefetchScope prefetch(spec.classes.is_empty() ? nullptr : &spec);
+						variant_to_bert(result, &reply);
+					} else {
+						variant_to_bert(result, &reply);
+					}
+				} else {
+					ei_x_encode_tuple_header(&reply, 2);
+					ei_x_encode_atom(&reply, "error");
+					ei_x_encode_string(&reply, "object_not_found");
+				}
+			} else {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "insufficient_arguments");
+			}
+		} else if (strcmp(function, "get_property") == 0) {
+			if (args.size() >= 2) {
+				String prop_name = args[1].operator String();
+
+				Object *obj = resolve_object_arg(args[0]);
+				if (obj != nullptr) {
+					Variant value = obj->get(prop_name);
+					if (args.size() > 2) {
+						CNodePrefetchSpec spec = parse_prefetch_spec(args[2]);
+						CNodePrefetchScope prefetch(spec.classes.is_empty() ? nullptr : &spec);
+						variant_to_bert(value, &reply);
+					} else {
+						variant_to_bert(value, &reply);
+					}
+				} else {
+					ei_x_encode_tuple_header(&reply, 2);
+					ei_x_encode_atom(&reply, "error");
+					ei_x_encode_string(&reply, "object_not_found");
+				}
+			} else {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "insufficient_arguments");
+			}
+		} else if (strcmp(function, "set_property") == 0) {
+			if (args.size() >= 3) {
+				String prop_name = args[1].operator String();
+				Variant value = args[2];
+
+				Object *obj = resolve_object_arg(args[0]);
+				if (obj != nullptr) {
+					obj->set(prop_name, value);
+					ei_x_encode_atom(&reply, "ok");
+				} else {
+					ei_x_encode_tuple_header(&reply, 2);
+					ei_x_encode_atom(&reply, "error");
+					ei_x_encode_string(&reply, "object_not_found");
+				}
+			} else {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "insufficient_arguments");
+			}
+		} else if (strcmp(function, "list_classes") == 0 || strcmp(function, "get_singletons") == 0) {
+			// Pre-encoded lists, copied straight into the reply
+			CNodeServer *server = CNodeServer::get_singleton();
+			if (server == nullptr) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "server_not_available");
+			} else {
+				CNodeClassMetadata &metadata = server->get_class_metadata();
+				CNodeClassMetadata::Blob blob = strcmp(function, "list_classes") == 0 ? metadata.get_class_list() : metadata.get_singleton_list();
+				ei_x_append_buf(&reply, blob.data, blob.size);
+			}
+		} else if (strcmp(function, "get_class_methods") == 0 || strcmp(function, "get_class_properties") == 0 ||
+				strcmp(function, "get_class_signals") == 0 || strcmp(function, "get_class_enums") == 0) {
+			// Methods: [{Name, ReturnType, [{ArgName, ArgType}], Flags}], properties: [{Name, Type, ClassName}],
+			// signals: [{Name, [{ArgName, ArgType}]}], enums: [{EnumName, [{Constant, Value}]}]
+			CNodeServer *server = CNodeServer::get_singleton();
+			CNodeClassMetadata::Section section = CNodeClassMetadata::SECTION_ENUMS;
+			if (strcmp(function, "get_class_methods") == 0) {
+				section = CNodeClassMetadata::SECTION_METHODS;
+			} else if (strcmp(function, "get_class_properties") == 0) {
+				section = CNodeClassMetadata::SECTION_PROPERTIES;
+			} else if (strcmp(function, "get_class_signals") == 0) {
+				section = CNodeClassMetadata::SECTION_SIGNALS;
+			}
+			CNodeClassMetadata::Blob blob;
+			if (server == nullptr || args.size() < 1 ||
+					!server->get_class_metadata().get_class_section(args[0].operator String(), section, blob)) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "class_not_found");
+			} else {
+				ei_x_append_buf(&reply, blob.data, blob.size);
+			}
+		} else if (strcmp(function, "get_singleton") == 0) {
+			// {call, godot, get_singleton, [Name]} - engine singletons, plus SceneTree
+			String name = args.size() > 0 ? args[0].operator String() : String();
+			Engine *engine = Engine::get_singleton();
+			Object *singleton = nullptr;
+			if (name == "SceneTree") {
+				singleton = get_scene_tree();
+			} else if (!name.is_empty() && engine->has_singleton(name)) {
+				singleton = engine->get_singleton(name);
+			}
+			if (singleton == nullptr) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "singleton_not_found");
+			} else {
+				variant_to_bert(Variant(singleton), &reply);
+			}
+		} else if (strcmp(function, "create_object") == 0) {
+			// {call, godot, create_object, [ClassName]}
+			String class_name = args.size() > 0 ? args[0].operator String() : String();
+			CNodeServer *server = CNodeServer::get_singleton();
+			if (class_name.is_empty() || !ClassDB::class_exists(class_name) || !ClassDBSingleton::get_singleton()->can_instantiate(class_name)) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "class_not_instantiable");
+			} else {
+				Variant instance = ClassDBSingleton::get_singleton()->instantiate(class_name);
+				Object *obj = instance.operator Object *();
+				if (obj != nullptr && obj->is_class("RefCounted") && server != nullptr) {
+					server->keep_created_object(fd, instance); // Otherwise freed with this Variant
+				}
+				variant_to_bert(instance, &reply);
+			}
+		} else if (strcmp(function, "get_scene_tree_root") == 0 || strcmp(function, "find_node") == 0) {
+			// {call, godot, find_node, [NodePath]} - relative to the current scene, or absolute
+			SceneTree *tree = get_scene_tree();
+			Node *node = nullptr;
+			if (strcmp(function, "get_scene_tree_root") == 0) {
+				node = tree != nullptr ? tree->get_root() : nullptr;
+			} else if (args.size() > 0) {
+				node = find_node_by_path(tree, args[0].operator String());
+			}
+			if (node == nullptr) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "node_not_found");
+			} else {
+				variant_to_bert(Variant(node), &reply);
+			}
+		} else if (strcmp(function, "query") == 0) {
+			// {call, godot, query, [Root, Filter, Fields]} - one tree walk, one reply
+			Node *root = resolve_query_root(args.size() > 0 ? args[0] : Variant());
+			if (root != nullptr) {
+				NodeQueryFilter filter = parse_query_filter(args.size() > 1 ? args[1] : Variant());
+				LocalVector<StringName> fields = to_property_names(args.size() > 2 ? args[2] : Variant());
+				LocalVector<Node *> matches;
+				collect_query_matches(root, filter, matches);
+				encode_query_rows(matches, fields, &reply);
+			} else {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "node_not_found");
+			}
+		} else if (strcmp(function, "get_properties") == 0) {
+			// {call, godot, get_properties, [[Id...], [Prop...]]} - one column per property, in Prop order
+			CNodeServer *server = CNodeServer::get_singleton();
+			if (server == nullptr || args.size() < 2) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "insufficient_arguments");
+			} else {
+				Array ids = decode_id_list_arg(buf, args_index, 0);
+				LocalVector<Object *> objects;
+				objects.resize(ids.size());
+				for (int64_t i = 0; i < ids.size(); i++) {
+					objects[i] = resolve_object_arg(ids[i]);
+				}
+				encode_property_columns(server, objects, to_property_names(args[1]), &reply);
+			}
+		} else if (strcmp(function, "set_properties") == 0) {
+			// {call, godot, set_properties, [[Id...], [{Prop, Column}...]]} - Column is {f64|i64|vec3, Binary} or a list
+			Array ids = decode_id_list_arg(buf, args_index, 0);
+			LocalVector<PropertyColumn> columns;
+			if (!parse_property_columns(buf, args_index, 1, ids.size(), columns)) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "invalid_columns");
+			} else {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "ok");
+				ei_x_encode_long(&reply, apply_property_columns(ids, columns));
+			}
+		} else if (strcmp(function, "snapshot") == 0) {
+			// {call, godot, snapshot, [Root, Fields]} - whole subtree in one encode pass
+			Node *root = resolve_query_root(args.size() > 0 ? args[0] : Variant());
+			if (root != nullptr) {
+				NodeQueryFilter match_all = parse_query_filter(Variant());
+				LocalVector<StringName> fields = to_property_names(args.size() > 1 ? args[1] : Variant());
+				LocalVector<Node *> nodes;
+				collect_query_matches(root, match_all, nodes);
+				encode_snapshot_rows(nodes, fields, &reply);
+			} else {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "node_not_found");
+			}
+		} else if (strcmp(function, "watch_tree") == 0 || strcmp(function, "unwatch_tree") == 0) {
+			// {call, godot, watch_tree, [Root, Pid]} / {call, godot, unwatch_tree, [Pid]} - Pid defaults to the caller
+			bool watch = strcmp(function, "watch_tree") == 0;
+			erlang_pid subscriber = *from_pid;
+			decode_pid_arg(buf, args_index, watch ? 1 : 0, &subscriber);
+			CNodeServer *server = CNodeServer::get_singleton();
+			Node *root = watch ? resolve_query_root(args.size() > 0 ? args[0] : Variant()) : nullptr;
+			if (server == nullptr) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "server_not_available");
+			} else if (watch && root == nullptr) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "node_not_found");
+			} else {
+				if (watch) {
+					server->watch_tree(fd, subscriber, root);
+				} else {
+					server->unwatch_tree(subscriber);
+				}
+				ei_x_encode_atom(&reply, "ok");
+			}
+		} else if (strcmp(function, "spawn_tree") == 0) {
+			// {call, godot, spawn_tree, [ParentId, Spec]} or [ParentId, Spec, #{batch => N}] to spread over frames
+			Node *target = resolve_query_root(args.size() > 0 ? args[0] : Variant());
+			LocalVector<CNodeSpawnEntry> entries;
+			int spec_index;
+			bool spec_ok = seek_arg(buf, args_index, 1, &spec_index) && parse_spawn_spec(buf, &spec_index, -1, entries);
+			int batch = 0;
+			if (args.size() > 2 && args[2].get_type() == Variant::DICTIONARY) {
+				batch = (int)args[2].operator Dictionary().get("batch", 0).operator int64_t();
+			}
+			CNodeServer *server = CNodeServer::get_singleton();
+
+			if (target == nullptr) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "node_not_found");
+			} else if (!spec_ok) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "invalid_spec");
+			} else if (batch > 0 && server != nullptr && (int)entries.size() > batch) {
+				// Multi-frame: reply now, {spawned, JobId, Ids} follows once the last batch is in
+				uint64_t job_id = server->start_spawn_job(fd, *from_pid, *tag_ref, target, entries, batch);
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "pending");
+				ei_x_encode_ulonglong(&reply, job_id);
+			} else {
+				// Build detached, then enter the tree once
+				LocalVector<ObjectID> ids;
+				spawn_entries(entries, 0, entries.size(), target, false, ids);
+				for (uint32_t i = 0; i < entries.size(); i++) {
+					Node *node = Object::cast_to<Node>(ObjectDB::get_instance(ids[i]));
+					if (entries[i].parent < 0 && node != nullptr) {
+						target->add_child(node);
+					}
+				}
+				encode_spawned_ids(ids, &reply);
+			}
+		} else if (strcmp(function, "instantiate") == 0) {
+			// {call, godot, instantiate, [Path, Count, Parent]} - Parent 0/nil leaves the instances detached
+			String path = args.size() > 0 ? args[0].operator String() : String();
+			int64_t count = args.size() > 1 ? args[1].operator int64_t() : 1;
+			bool attach = args.size() > 2 && args[2].get_type() != Variant::NIL && !(args[2].get_type() == Variant::INT && args[2].operator int64_t() == 0);
+			Node *parent = attach ? resolve_query_root(args[2]) : nullptr;
+			CNodeServer *server = CNodeServer::get_singleton();
+
+			if (server == nullptr) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "server_not_available");
+			} else if (attach && parent == nullptr) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "node_not_found");
+			} else if (count <= 0 || count > INSTANTIATE_MAX_COUNT) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "invalid_count");
+			} else if (server->get_cached_scene(path).is_null()) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "scene_not_found");
+			} else {
+				LocalVector<ObjectID> ids;
+				ids.reserve((uint32_t)count);
+				for (int64_t i = 0; i < count; i++) {
+					Node *node = server->acquire_scene_instance(path);
+					if (node != nullptr && parent != nullptr) {
+						parent->add_child(node);
+					} else if (node != nullptr) {
+						server->track_detached_instance(fd, node);
+					}
+					ids.push_back(ObjectID(node != nullptr ? node->get_instance_id() : (uint64_t)0));
+				}
+				encode_spawned_ids(ids, &reply);
+			}
+		} else if (strcmp(function, "release") == 0) {
+			// {call, godot, release, [[Id, ...]]} - detach scene instances and keep them for reuse
+			CNodeServer *server = CNodeServer::get_singleton();
+			Array ids = decode_id_list_arg(buf, args_index, 0);
+			// Nothing is released when any live ID is not a scene instance (or is the current scene)
+			bool releasable = server != nullptr;
+			for (int i = 0; releasable && i < ids.size(); i++) {
+				Node *node = get_node_by_id(ids[i].operator int64_t());
+				releasable = node == nullptr || server->is_releasable_scene_instance(node);
+			}
+			if (!releasable) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, server == nullptr ? "server_not_available" : "not_a_scene_instance");
+			} else {
+				int pooled = 0;
+				for (int i = 0; i < ids.size(); i++) {
+					pooled += server->release_scene_instance(get_node_by_id(ids[i].operator int64_t())) ? 1 : 0;
+				}
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "ok");
+				ei_x_encode_long(&reply, pooled);
+			}
+		} else if (strcmp(function, "clear_scene_cache") == 0) {
+			CNodeServer *server = CNodeServer::get_singleton();
+			if (server != nullptr) {
+				server->clear_scene_cache();
+			}
+			ei_x_encode_atom(&reply, "ok");
+		} else if (strcmp(function, "load_async") == 0) {
+			// {call, godot, load_async, [Path, TypeHint, Pid]} - Pid (defaults to the caller) gets
+			// {load_progress, Path, Progress} while loading and {loaded, Path, Id} or {load_failed, Path} at the end
+			String path = args.size() > 0 ? args[0].operator String() : String();
+			String type_hint = args.size() > 1 && args[1].get_type() == Variant::STRING ? args[1].operator String() : String();
+			erlang_pid subscriber = *from_pid;
+			decode_pid_arg(buf, args_index, 2, &subscriber);
+			CNodeServer *server = CNodeServer::get_singleton();
+
+			if (server == nullptr) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "server_not_available");
+			} else if (path.is_empty() || !server->load_async(fd, subscriber, *tag_ref, path, type_hint)) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "load_request_failed");
+			} else {
+				ei_x_encode_atom(&reply, "ok");
+			}
+		} else if (strcmp(function, "unload") == 0) {
+			// {call, godot, unload, [Path]} - drop the reference held since load_async completed
+			CNodeServer *server = CNodeServer::get_singleton();
+			if (server != nullptr && args.size() > 0) {
+				server->unload_resource(args[0].operator String());
+			}
+			ei_x_encode_atom(&reply, "ok");
+		} else if (strcmp(function, "raycast_batch") == 0) {
+			// {call, godot, raycast_batch, [SpaceOrWorldId, RaysBinary, Mask]}
+			Engine *engine = Engine::get_singleton();
+			CNodeServer *server = CNodeServer::get_singleton();
+			if (!engine->is_in_physics_frame() && server != nullptr) {
+				// Re-run this call on the next physics tick, which sends the reply
+				int request_end = request_index;
+				ei_skip_term(buf, &request_end);
+				server->schedule_physics_call(engine->get_physics_frames(), buf + request_index, request_end - request_index, fd, *from_pid, *tag_ref);
+				ei_x_free(&reply);
+				return 0;
+			}
+
+			Ref<World3D> world = resolve_world_3d(args.size() > 0 ? args[0].operator int64_t() : 0);
+			PhysicsDirectSpaceState3D *space = world.is_valid() ? world->get_direct_space_state() : nullptr;
+			PackedFloat32Array rays;
+			uint32_t mask = args.size() > 2 && args[2].get_type() == Variant::INT ? (uint32_t)args[2].operator int64_t() : 0xFFFFFFFF;
+			if (world.is_null()) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "world_not_found");
+			} else if (space == nullptr) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "space_not_found");
+			} else if (!decode_float32_binary_arg(buf, args_index, 1, rays) || rays.size() % 6 != 0) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "invalid_rays");
+			} else {
+				encode_raycast_batch(space, rays, mask, &reply);
+			}
+		} else if (strcmp(function, "nav_path_batch") == 0) {
+			// {call, godot, nav_path_batch, [MapOrWorldId, QueriesBinary, Opts]}
+			// Opts: #{optimize => bool, batch => N} - with batch, N queries run per frame and {nav_paths, JobId, Binary} follows
+			RID map = resolve_navigation_map(args.size() > 0 ? args[0].operator int64_t() : 0);
+			Dictionary opts = args.size() > 2 && args[2].get_type() == Variant::DICTIONARY ? args[2].operator Dictionary() : Dictionary();
+			bool optimize = opts.get("optimize", true).operator bool();
+			int batch = (int)opts.get("batch", 0).operator int64_t();
+			PackedFloat32Array queries;
+			CNodeServer *server = CNodeServer::get_singleton();
+
+			if (!map.is_valid()) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "world_not_found");
+			} else if (!decode_float32_binary_arg(buf, args_index, 1, queries) || queries.size() % 7 != 0) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "invalid_queries");
+			} else if (batch > 0 && server != nullptr && queries.size() / 7 > batch) {
+				uint64_t job_id = server->start_nav_path_job(fd, *from_pid, *tag_ref, map, queries, optimize, batch);
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "pending");
+				ei_x_encode_ulonglong(&reply, job_id);
+			} else {
+				LocalVector<uint32_t> offsets;
+				LocalVector<float> points;
+				run_nav_path_queries(map, queries, 0, queries.size() / 7, optimize, offsets, points);
+				encode_nav_paths(offsets, points, &reply);
+			}
+		} else if (strcmp(function, "multimesh_set_buffer") == 0 || strcmp(function, "multimesh_update") == 0) {
+			// {call, godot, multimesh_set_buffer, [MultiMeshId, Binary]} - whole buffer, applied now
+			// {call, godot, multimesh_update, [MultiMeshId, FirstInstance, Binary]} - range, uploaded at the end of the frame
+			bool ranged = strcmp(function, "multimesh_update") == 0;
+			MultiMesh *multimesh = resolve_multimesh(args.size() > 0 ? args[0].operator int64_t() : 0);
+			PackedFloat32Array values;
+			CNodeServer *server = CNodeServer::get_singleton();
+			if (multimesh == nullptr || server == nullptr) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "multimesh_not_found");
+			} else if (!decode_float32_binary_arg(buf, args_index, ranged ? 2 : 1, values)) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "invalid_buffer");
+			} else {
+				bool applied = ranged
+						? server->multimesh_update(multimesh, args.size() > 1 ? args[1].operator int64_t() : 0, values)
+						: server->multimesh_set_buffer(multimesh, values);
+				if (applied) {
+					ei_x_encode_atom(&reply, "ok");
+				} else {
+					ei_x_encode_tuple_header(&reply, 2);
+					ei_x_encode_atom(&reply, "error");
+					ei_x_encode_string(&reply, "buffer_size_mismatch");
+				}
+			}
+		} else if (strcmp(function, "rid_instances_create") == 0) {
+			// {call, godot, rid_instances_create, [BaseId, WorldId, Count]} - BaseId is a Mesh (or other instanceable resource)
+			Resource *base = Object::cast_to<Resource>(get_object_by_id(args.size() > 0 ? args[0].operator int64_t() : 0));
+			Ref<World3D> world = resolve_world_3d(args.size() > 1 ? args[1].operator int64_t() : 0);
+			int count = args.size() > 2 ? (int)args[2].operator int64_t() : 1;
+			CNodeServer *server = CNodeServer::get_singleton();
+
+			if (base == nullptr || world.is_null() || server == nullptr) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, base == nullptr ? "base_not_found" : "world_not_found");
+			} else if (count <= 0) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "invalid_count");
+			} else {
+				LocalVector<uint32_t> handles;
+				server->create_rid_instances(fd, base->get_rid(), world->get_scenario(), count, handles);
+				encode_rid_handles(handles, &reply);
+			}
+		} else if (strcmp(function, "rid_bodies_create") == 0) {
+			// {call, godot, rid_bodies_create, [ShapeId, WorldId, Count, Mode]} - Mode is a PhysicsServer3D.BodyMode (default rigid)
+			Resource *shape = Object::cast_to<Resource>(get_object_by_id(args.size() > 0 ? args[0].operator int64_t() : 0));
+			Ref<World3D> world = resolve_world_3d(args.size() > 1 ? args[1].operator int64_t() : 0);
+			int count = args.size() > 2 ? (int)args[2].operator int64_t() : 1;
+			int mode = args.size() > 3 ? (int)args[3].operator int64_t() : PhysicsServer3D::BODY_MODE_RIGID;
+			CNodeServer *server = CNodeServer::get_singleton();
+
+			if (shape == nullptr || world.is_null() || server == nullptr) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, shape == nullptr ? "shape_not_found" : "world_not_found");
+			} else if (count <= 0 || mode < PhysicsServer3D::BODY_MODE_STATIC || mode > PhysicsServer3D::BODY_MODE_RIGID_LINEAR) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "invalid_arguments");
+			} else {
+				LocalVector<uint32_t> handles;
+				server->create_rid_bodies(fd, shape->get_rid(), world->get_space(), mode, count, handles);
+				encode_rid_handles(handles, &reply);
+			}
+		} else if (strcmp(function, "rid_set_transforms") == 0 || strcmp(function, "rid_free") == 0) {
+			// {call, godot, rid_set_transforms, [RecordsBinary]} / {call, godot, rid_free, [HandlesBinary]}
+			bool transforms = strcmp(function, "rid_set_transforms") == 0;
+			size_t record_size = transforms ? sizeof(RidTransformRecord) : sizeof(uint32_t);
+			PackedByteArray bytes;
+			CNodeServer *server = CNodeServer::get_singleton();
+			if (server == nullptr || !decode_byte_binary_arg(buf, args_index, 0, bytes) || bytes.size() % record_size != 0) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "invalid_records");
+			} else {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "ok");
+				ei_x_encode_long(&reply, transforms ? apply_rid_transforms(server, fd, bytes) : free_rid_handles(server, fd, bytes));
+			}
+		} else if (strcmp(function, "lockstep") == 0) {
+			// {call, godot, lockstep, [Enabled]}
+			CNodeServer *server = CNodeServer::get_singleton();
+			if (server == nullptr) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "server_not_available");
+			} else {
+				server->set_lockstep(fd, args.size() > 0 && args[0].operator bool());
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "ok");
+				ei_x_encode_ulonglong(&reply, Engine::get_singleton()->get_physics_frames());
+			}
+		} else if (strcmp(function, "step") == 0) {
+			// {call, godot, step, [N, Ops, Ids, Fields]} - apply the Ops casts, run N physics ticks, reply {ok, PhysicsFrame, Rows}
+			CNodeServer *server = CNodeServer::get_singleton();
+			int64_t ticks = args.size() > 0 ? args[0].operator int64_t() : 1;
+			if (server == nullptr || !server->is_lockstep()) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "not_in_lockstep");
+			} else if (ticks < 0) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "invalid_ticks");
+			} else {
+				LocalVector<ObjectID> ids;
+				Array id_list = decode_id_list_arg(buf, args_index, 2);
+				for (int64_t i = 0; i < id_list.size(); i++) {
+					Object *obj = get_object_by_id(id_list[i].operator int64_t());
+					ids.push_back(ObjectID(obj != nullptr ? obj->get_instance_id() : (uint64_t)0));
+				}
+				LocalVector<StringName> fields = to_property_names(args.size() > 3 ? args[3] : Variant());
+
+				if (ticks == 0) {
+					run_cast_list_arg(buf, args_index, 1);
+					ei_x_encode_tuple_header(&reply, 3);
+					ei_x_encode_atom(&reply, "ok");
+					ei_x_encode_ulonglong(&reply, Engine::get_singleton()->get_physics_frames());
+					encode_step_state(ids, fields, &reply);
+				} else if (server->is_step_pending()) {
+					ei_x_encode_tuple_header(&reply, 2);
+					ei_x_encode_atom(&reply, "error");
+					ei_x_encode_string(&reply, "step_in_progress");
+				} else {
+					server->begin_step(fd, server->defer_reply(fd, *from_pid, *tag_ref, 0), (uint64_t)ticks, ids, fields);
+					// Ops land before the first granted tick; the reply follows the last one
+					run_cast_list_arg(buf, args_index, 1);
+					ei_x_free(&reply);
+					return 0;
+				}
+			}
+		} else if (strcmp(function, "set_prefetch") == 0) {
+			// {call, godot, set_prefetch, [Spec]} - Spec: #{Class => [Prop...]}, empty to turn prefetching off
+			CNodeServer *server = CNodeServer::get_singleton();
+			if (server == nullptr) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "server_not_available");
+			} else {
+				server->set_prefetch(fd, parse_prefetch_spec(args.size() > 0 ? args[0] : Variant()));
+				ei_x_encode_atom(&reply, "ok");
+			}
+		} else if (strcmp(function, "use_handles") == 0) {
+			// {call, godot, use_handles, [Enabled]} - object IDs on this connection become small generation-checked handles
+			CNodeServer *server = CNodeServer::get_singleton();
+			if (server == nullptr) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "server_not_available");
+			} else {
+				server->set_object_handles(fd, args.size() > 0 && args[0].operator bool());
+				ei_x_encode_atom(&reply, "ok");
+			}
+		} else if (strcmp(function, "wait_frames") == 0) {
+			// {call, godot, wait_frames, [N, TimeoutMs]} - replies {ok, ProcessFrame} N process frames from now
+			CNodeServer *server = CNodeServer::get_singleton();
+			int64_t frames = args.size() > 0 ? args[0].operator int64_t() : 1;
+			int64_t timeout_ms = args.size() > 1 ? args[1].operator int64_t() : 0;
+			if (server == nullptr || frames < 0) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, server == nullptr ? "server_not_available" : "invalid_frames");
+			} else {
+				uint64_t reply_id = server->defer_reply(fd, *from_pid, *tag_ref, timeout_ms);
+				server->wait_frames(reply_id, Engine::get_singleton()->get_process_frames() + frames);
+				ei_x_free(&reply);
+				return 0;
+			}
+		} else if (strcmp(function, "await_signal") == 0) {
+			// {call, godot, await_signal, [ObjectId, Signal, TimeoutMs]} - replies {ok, Args} on the next emission
+			CNodeServer *server = CNodeServer::get_singleton();
+			Object *obj = args.size() >= 2 ? resolve_object_arg(args[0]) : nullptr;
+			int64_t timeout_ms = args.size() > 2 ? args[2].operator int64_t() : 0;
+			if (server == nullptr) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "server_not_available");
+			} else if (obj == nullptr) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, args.size() < 2 ? "insufficient_arguments" : "object_not_found");
+			} else {
+				uint64_t reply_id = server->defer_reply(fd, *from_pid, *tag_ref, timeout_ms);
+				if (server->await_signal(reply_id, obj, StringName(args[1].operator String())) != OK) {
+					// Nothing will ever answer it, so answer now
+					ei_x_encode_tuple_header(&reply, 2);
+					ei_x_encode_atom(&reply, "error");
+					ei_x_encode_string(&reply, "signal_not_found");
+					server->complete_reply(reply_id, &reply);
+				}
+				ei_x_free(&reply);
+				return 0;
+			}
+		} else if (strcmp(function, "get_stats") == 0) {
+			// {call, godot, get_stats, []} - request counters and clock_ms, the clock deadline_ms is measured on
+			CNodeServer *server = CNodeServer::get_singleton();
+			if (server == nullptr) {
+				ei_x_encode_tuple_header(&reply, 2);
+				ei_x_encode_atom(&reply, "error");
+				ei_x_encode_string(&reply, "server_not_available");
+			} else {
+				const CNodeRequestStats &stats = server->get_stats();
+				ei_x_encode_map_header(&reply, 10);
+				ei_x_encode_atom(&reply, "peers");
+				ei_x_encode_ulong(&reply, server->get_scheduler().get_peer_fds().size());
+				ei_x_encode_atom(&reply, "queued");
+				ei_x_encode_ulong(&reply, server->get_scheduler().size());
+				ei_x_encode_atom(&reply, "scheduled");
+				ei_x_encode_ulong(&reply, server->get_scheduled_count());
+				ei_x_encode_atom(&reply, "clock_ms");
+				ei_x_encode_ulonglong(&reply, Time::get_singleton()->get_ticks_msec());
+				ei_x_encode_atom(&reply, "expired_calls");
+				ei_x_encode_ulonglong(&reply, stats.expired_calls);
+				ei_x_encode_atom(&reply, "expired_casts");
+				ei_x_encode_ulonglong(&reply, stats.expired_casts);
+				ei_x_encode_atom(&reply, "overloaded_calls");
+				ei_x_encode_ulonglong(&reply, stats.overloaded_calls);
+				ei_x_encode_atom(&reply, "inbound_high_water");
+				ei_x_encode_ulong(&reply, server->get_scheduler().get_inbound_high_water());
+				ei_x_encode_atom(&reply, "inbound_high_water_bytes");
+				ei_x_encode_ulonglong(&reply, server->get_scheduler().get_inbound_high_water_bytes());
+				ei_x_encode_atom(&reply, "outbound_high_water_bytes");
+				ei_x_encode_ulonglong(&reply, server->get_scheduler().get_outbound_high_water_bytes());
+			}
+		} else if (strcmp(function, "get_frames") == 0) {
+			// {PhysicsFrame, ProcessFrame} - reference point for call_at schedules
+			Engine *engine = Engine::get_singleton();
+			ei_x_encode_tuple_header(&reply, 2);
+			ei_x_encode_ulonglong(&reply, engine != nullptr ? engine->get_physics_frames() : 0);
+			ei_x_encode_ulonglong(&reply, engine != nullptr ? engine->get_process_frames() : 0);
+		} else {
+			ei_x_encode_tuple_header(&reply, 2);
+			ei_x_encode_atom(&reply, "error");
+			ei_x_encode_string(&reply, "unknown_function");
+		}
+	} else if (strcmp(module, "erlang") == 0) {
+		// Erlang built-in functions
+		if (strcmp(function, "node") == 0) {
+			// {call, erlang, node, []} - return the CNode's name
+			// Reply format: just the node name atom (not wrapped in {reply, ...})
+			ei_x_encode_atom(&reply, ec.thisnodename);
+		} else if (strcmp(function, "nodes") == 0) {
+			// {call, erlang, nodes, []} - return list of connected nodes
+			// Reply format: just the list (not wrapped in {reply, ...})
+			// Return empty list for now (CNode doesn't track connected nodes)
+			ei_x_encode_list_header(&reply, 0);
+			ei_x_encode_empty_list(&reply);
+		} else {
+			// Unknown function in erlang module
+			ei_x_encode_tuple_header(&reply, 2);
+			ei_x_encode_atom(&reply, "error");
+			ei_x_encode_string(&reply, "unknown_function");
+		}
+	} else {
+		// Unknown module
+		ei_x_encode_tuple_header(&reply, 2);
+		ei_x_encode_atom(&reply, "error");
+		ei_x_encode_string(&reply, "unknown_module");
+	}
+
+	/* Send GenServer-style reply */
+	send_reply(&reply, fd, from_pid, tag_ref);
+	ei_x_free(&reply);
+
+	return 0;
+}
+
+/*
+ * Handle {cast, godot, call_at, [When, Op]}
+ * When is a physics frame number, {process_frame, N} or {after_ms, N}
+ * Op is a {Module, Function, Args} cast, kept encoded and dispatched through handle_cast when due
+ */
+static int handle_call_at(char *buf, int *index) {
+	CNodeServer *server = CNodeServer::get_singleton();
+	Engine *engine = Engine::get_singleton();
+	if (server == nullptr || engine == nullptr) {
+		printf("Godot CNode: Async godot:call_at - Error: CNodeServer not available\n");
+		return -1;
+	}
+
+	int arity;
+	if (ei_decode_list_header(buf, index, &arity) < 0 || arity < 2) {
+		printf("Godot CNode: Async godot:call_at - Error: Insufficient arguments\n");
+		return -1;
+	}
+
+	// Decode When
+	int type, size;
+	ei_get_type(buf, index, &type, &size);
+	bool idle_hook = false;
+	long long target_frame = 0;
+	if (type == ERL_SMALL_TUPLE_EXT) {
+		int when_arity;
+		char when_atom[MAXATOMLEN];
+		long long amount;
+		if (ei_decode_tuple_header(buf, index, &when_arity) < 0 || when_arity != 2 ||
+				ei_decode_atom(buf, index, when_atom) < 0 || ei_decode_longlong(buf, index, &amount) < 0) {
+			printf("Godot CNode: Async godot:call_at - Error: Invalid schedule term\n");
+			return -1;
+		}
+		if (strcmp(when_atom, "after_ms") == 0) {
+			// Round up to whole physics ticks so the op never fires early
+			long long ticks_per_second = engine->get_physics_ticks_per_second();
+			long long ticks = (amount * ticks_per_second + 999) / 1000;
+			target_frame = (long long)engine->get_physics_frames() + (ticks > 0 ? ticks : 0);
+		} else if (strcmp(when_atom, "process_frame") == 0) {
+			idle_hook = true;
+			target_frame = amount;
+		} else {
+			printf("Godot CNode: Async godot:call_at - Error: Unknown schedule kind: %s\n", when_atom);
+			return -1;
+		}
+	} else if (ei_decode_longlong(buf, index, &target_frame) < 0) {
+		printf("Godot CNode: Async godot:call_at - Error: Invalid frame number\n");
+		return -1;
+	}
+
+	// Keep Op encoded until it is due
+	int op_start = *index;
+	if (ei_skip_term(buf, index) < 0) {
+		printf("Godot CNode: Async godot:call_at - Error: Invalid operation term\n");
+		return -1;
+	}
+	if (target_frame < 0) {
+		target_frame = 0;
+	}
+
+	if (idle_hook) {
+		server->schedule_idle_request((uint64_t)target_frame, buf + op_start, *index - op_start);
+	} else {
+		server->schedule_physics_request((uint64_t)target_frame, buf + op_start, *index - op_start);
+	}
+	printf("Godot CNode: Async godot:call_at - Scheduled for %s frame %lld\n", idle_hook ? "process" : "physics", target_frame);
+	return 0;
+}
+
+/*
+ * Handle asynchronous cast from Erlang/Elixir (GenServer-like cast)
+ */
+static int handle_cast(char *buf, int *index) {
+	// Guard: Check for null pointers
+	if (buf == nullptr || index == nullptr) {
+		fprintf(stderr, "Error: null pointer in handle_cast\n");
+		return -1;
+	}
+
+	/* Decode Request: {Module, Function, Args} */
+	int request_arity;
+	if (ei_decode_tuple_header(buf, index, &request_arity) < 0 || request_arity < 2) {
+		fprintf(stderr, "Error: invalid request format in gen_cast\n");
+		return -1;
+	}
+
+	/* Decode Module and Function from Request tuple */
+	char module[256];
+	char function[256];
+
+	if (ei_decode_atom(buf, index, module) < 0) {
+		fprintf(stderr, "Error decoding module in cast\n");
+		return -1;
+	}
+
+	if (ei_decode_atom(buf, index, function) < 0) {
+		fprintf(stderr, "Error decoding function in cast\n");
+		return -1;
+	}
+
+	// Scheduled casts keep their operation encoded, so decode them before the generic argument conversion
+	if (strcmp(module, "godot") == 0 && strcmp(function, "call_at") == 0 && request_arity > 2) {
+		return handle_call_at(buf, index);
+	}
+
+	// Decode arguments (remaining elements in Request tuple)
+	Array args;
+	int args_index = *index;
+	if (request_arity > 2) {
+		// Decode args array
+		Variant args_variant = bert_to_variant(buf, index, true); // Skip version, already in tuple
+		if (args_variant.get_type() == Variant::ARRAY) {
+			args = args_variant.operator Array();
+			printf("Godot CNode: handle_cast - Decoded args array with %lld elements\n", (long long)args.size());
+		} else {
+			// Single argument, wrap in array
+			args.push_back(args_variant);
+			printf("Godot CNode: handle_cast - Decoded single arg, wrapped in array\n");
+		}
+		fflush(stdout);
+	}
+
+	if (request_arity > 3 && request_expired(bert_to_variant(buf, index, true))) {
+		CNodeServer *server = CNodeServer::get_singleton();
+		if (server != nullptr) {
+			server->count_expired_request(false);
+		}
+		printf("Godot CNode: Async %s:%s - Skipped, deadline passed\n", module, function);
+		return 0;
+	}
+
+	// Route based on module (async, no reply)
+	printf("Godot CNode: Processing async message - Module: %s, Function: %s\n", module, function);
+	fflush(stdout);
+
+	if (strcmp(module, "erlang") == 0) {
+		if (strcmp(function, "node") == 0) {
+			printf("Godot CNode: Async erlang:node - Node name: %s\n", ec.thisnodename);
+		} else if (strcmp(function, "nodes") == 0) {
+			printf("Godot CNode: Async erlang:nodes - No other connected nodes\n");
+		} else {
+			printf("Godot CNode: Async erlang:%s - Unknown function\n", function);
+		}
+	} else if (strcmp(module, "godot") == 0) {
+		// Generic Godot API calls - now safe since we're on main thread
+		if (strcmp(function, "call_method") == 0) {
+			if (args.size() >= 2) {
+				String method_name = args[1].operator String();
+				Array method_args;
+				if (args.size() > 2 && args[2].get_type() == Variant::ARRAY) {
+					method_args = args[2].operator Array();
+				}
+
+				// Get object and call method (async, no return value) using callv() - no argument limit!
+				Object *obj = resolve_object_arg(args[0]);
+				if (obj != nullptr) {
+					// Use callv() which accepts an Array of arguments - supports unlimited arguments
+					obj->callv(method_name, method_args);
+					printf("Godot CNode: Async godot:call_method - Success (called with %lld args)\n", (long long)method_args.size());
+				} else {
+					printf("Godot CNode: Async godot:call_method - Error: Object not found (%s)\n", String(args[0]).utf8().get_data());
+				}
+			} else {
+				printf("Godot CNode: Async godot:call_method - Error: Insufficient arguments\n");
+			}
+		} else if (strcmp(function, "set_property") == 0) {
+			if (args.size() >= 3) {
+				String prop_name = args[1].operator String();
+				Variant value = args[2];
+
+				Object *obj = resolve_object_arg(args[0]);
+				if (obj != nullptr) {
+					obj->set(prop_name, value);
+					printf("Godot CNode: Async godot:set_property - Success\n");
+				} else {
+					printf("Godot CNode: Async godot:set_property - Error: Object not found (%s)\n", String(args[0]).utf8().get_data());
+				}
+			} else {
+				printf("Godot CNode: Async godot:set_property - Error: Insufficient arguments\n");
+			}
+		} else if (strcmp(function, "multimesh_set_buffer") == 0 || strcmp(function, "multimesh_update") == 0) {
+			bool ranged = strcmp(function, "multimesh_update") == 0;
+			MultiMesh *multimesh = resolve_multimesh(args.size() > 0 ? args[0].operator int64_t() : 0);
+			PackedFloat32Array values;
+			CNodeServer *server = CNodeServer::get_singleton();
+			if (multimesh == nullptr || server == nullptr) {
+				printf("Godot CNode: Async godot:%s - Error: MultiMesh not found\n", function);
+			} else if (!decode_float32_binary_arg(buf, args_index, ranged ? 2 : 1, values)) {
+				printf("Godot CNode: Async godot:%s - Error: Invalid buffer\n", function);
+			} else if (ranged ? !server->multimesh_update(multimesh, args.size() > 1 ? args[1].operator int64_t() : 0, values)
+							  : !server->multimesh_set_buffer(multimesh, values)) {
+				printf("Godot CNode: Async godot:%s - Error: Buffer size mismatch\n", function);
+			}
+		} else if (strcmp(function, "set_properties") == 0) {
+			Array ids = decode_id_list_arg(buf, args_index, 0);
+			LocalVector<PropertyColumn> columns;
+			if (!parse_property_columns(buf, args_index, 1, ids.size(), columns)) {
+				printf("Godot CNode: Async godot:set_properties - Error: Invalid columns\n");
+			} else {
+				apply_property_columns(ids, columns);
+			}
+		} else if (strcmp(function, "rid_set_transforms") == 0 || strcmp(function, "rid_free") == 0) {
+			bool transforms = strcmp(function, "rid_set_transforms") == 0;
+			size_t record_size = transforms ? sizeof(RidTransformRecord) : sizeof(uint32_t);
+			PackedByteArray bytes;
+			CNodeServer *server = CNodeServer::get_singleton();
+			if (server == nullptr || !decode_byte_binary_arg(buf, args_index, 0, bytes) || bytes.size() % record_size != 0) {
+				printf("Godot CNode: Async godot:%s - Error: Invalid records\n", function);
+			} else if (transforms) {
+				apply_rid_transforms(server, current_request_fd, bytes);
+			} else {
+				free_rid_handles(server, current_request_fd, bytes);
+			}
+		} else if (strcmp(function, "cancel") == 0) {
+			// {cast, godot, cancel, [TagRef]} - the tag of a call, or the JobId from a {pending, JobId} reply
+			CNodeServer *server = CNodeServer::get_singleton();
+			int tag_index;
+			erlang_ref tag;
+			long long job_id = 0;
+			bool has_tag = false;
+			if (server != nullptr && seek_arg(buf, args_index, 0, &tag_index)) {
+				int ref_index = tag_index;
+				has_tag = ei_decode_ref(buf, &ref_index, &tag) == 0;
+				if (!has_tag && ei_decode_longlong(buf, &tag_index, &job_id) < 0) {
+					job_id = 0;
+				}
+			}
+			if (!has_tag && job_id <= 0) {
+				printf("Godot CNode: Async godot:cancel - Error: Expected a reference or job ID\n");
+			} else {
+				int cancelled = server->cancel_requests(has_tag ? &tag : nullptr, has_tag ? 0 : (uint64_t)job_id);
+				printf("Godot CNode: Async godot:cancel - Cancelled %d requests\n", cancelled);
+			}
+		} else if (strcmp(function, "release") == 0) {
+			CNodeServer *server = CNodeServer::get_singleton();
+			Array ids = decode_id_list_arg(buf, args_index, 0);
+			int released = 0;
+			for (int i = 0; server != nullptr && i < ids.size(); i++) {
+				Node *node = get_node_by_id(ids[i].operator int64_t());
+				if (node != nullptr && !server->is_releasable_scene_instance(node)) {
+					printf("Godot CNode: Async godot:release - Error: Not a scene instance\n");
+					continue;
+				}
+				released += node != nullptr ? 1 : 0;
+				server->release_scene_instance(node);
+			}
+			printf("Godot CNode: Async godot:release - Released %d instances\n", released);
+		} else {
+			printf("Godot CNode: Async godot:%s - Unknown function\n", function);
+		}
+	} else {
+		printf("Godot CNode: Async %s:%s - Unknown module\n", module, function);
+	}
+
+	printf("Godot CNode: Async message processing complete\n");
+	fflush(stdout);
+	return 0;
+}
+
+/*
+ * Helper: Write without blocking; returns the bytes written, 0 when the socket is full, -1 on error
+ */
+static int64_t send_nonblocking(int fd, const uint8_t *data, int64_t size) {
+#ifdef MSG_DONTWAIT
+	int flags = MSG_DONTWAIT;
+#ifdef MSG_NOSIGNAL
+	flags |= MSG_NOSIGNAL;
+#endif
+	ssize_t written = send(fd, data, size, flags);
+	if (written < 0) {
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+	}
+	return written;
+#else
+	// No per-call non-blocking flag: write a small chunk once select reports room
+	fd_set write_fds;
+	struct timeval timeout;
+	FD_ZERO(&write_fds);
+	FD_SET(fd, &write_fds);
+	timeout.tv_sec = 0;
+	timeout.tv_usec = 0;
+	if (select(fd + 1, NULL, &write_fds, NULL, &timeout) <= 0) {
+		return 0;
+	}
+	int written = send(fd, (const char *)data, (int)MIN(size, (int64_t)4096), 0);
+	return written < 0 ? -1 : written;
+#endif
+}
+
+/*
+ * Helper: Build the frame ei_send would write for a message to `to` (x holds the term with version byte)
+ * Frames are written by flush_outbound in as many pieces as the socket takes
+ */
+static void encode_send_frame(const erlang_pid *to, ei_x_buff *x, PackedByteArray &r_frame) {
+	static const char DIST_PASS_THROUGH = 'p';
+	ei_x_buff control;
+	ei_x_new_with_version(&control);
+	ei_x_encode_tuple_header(&control, 3);
+	ei_x_encode_long(&control, ERL_SEND);
+	ei_x_encode_atom(&control, ""); // Unused cookie
+	ei_x_encode_pid(&control, to);
+
+	uint32_t length = 1 + control.index + x->index;
+	r_frame.resize(4 + length);
+	uint8_t *out = r_frame.ptrw();
+	out[0] = (uint8_t)(length >> 24);
+	out[1] = (uint8_t)(length >> 16);
+	out[2] = (uint8_t)(length >> 8);
+	out[3] = (uint8_t)length;
+	out[4] = DIST_PASS_THROUGH;
+	memcpy(out + 5, control.buff, control.index);
+	memcpy(out + 5 + control.index, x->buff, x->index);
+	ei_x_free(&control);
+}
+
+/*
+ * Helper: Write the frames waiting for a connection's socket, as far as it takes them without blocking
+ */
+static void flush_outbound(CNodePeerScheduler &scheduler, int fd) {
+	const uint8_t *data;
+	int64_t size;
+	while (scheduler.peek_outbound(fd, data, size)) {
+		int64_t written = send_nonblocking(fd, data, size);
+		if (written == 0) {
+			return; // Socket full, the rest goes on a later frame
+		}
+		if (written < 0) {
+			// The connection is gone; the read side closes it, the frame is dropped
+			fprintf(stderr, "Godot CNode: Error sending queued message (errno: %d, %s)\n", errno, strerror(errno));
+			fflush(stderr);
+			written = size;
+		}
+		scheduler.consume_outbound(fd, written);
+	}
+}
+
+/*
+ * Helper: Queue an encoded term (with version byte) on a connection served by process_cnode_frame
+ * Returns false for connections without a queue (main_loop), which send directly
+ */
+static bool queue_outbound_term(int fd, erlang_pid *to_pid, ei_x_buff *x) {
+	CNodeServer *server = CNodeServer::get_singleton();
+	if (server == nullptr || !server->get_scheduler().has_peer(fd)) {
+		return false;
+	}
+	PackedByteArray frame;
+	encode_send_frame(to_pid, x, frame);
+	server->get_scheduler().queue_outbound(fd, frame);
+	flush_outbound(server->get_scheduler(), fd);
+	return true;
+}
+
+/*
+ * Send reply to Erlang/Elixir (GenServer-style synchronous call)
+ * Sends reply in format: {Tag, Reply} to the From PID
+ */
+static void send_reply(ei_x_buff *x, int fd, erlang_pid *to_pid, erlang_ref *tag_ref) {
+	// Guard: Check for null pointer
+	if (x == nullptr) {
+		fprintf(stderr, "Error: null reply buffer in send_reply\n");
+		return;
+	}
+
+	// Guard: Check for valid file descriptor
+	if (fd < 0) {
+		fprintf(stderr, "Error: invalid file descriptor in send_reply\n");
+		return;
+	}
+
+	// Guard: Check for valid PID and tag
+	if (to_pid == nullptr || tag_ref == nullptr) {
+		fprintf(stderr, "Error: null PID or tag in send_reply\n");
+		return;
+	}
+
+	/* Encode GenServer-style reply: {Tag, Reply} */
+	/* The reply buffer (x) already contains the reply data, we need to wrap it with the tag */
+	ei_x_buff gen_reply;
+	/* Use ei_x_new_with_version to ensure BERT version byte (0x83) is included */
+	/* This is required for ei_send to work correctly */
+	ei_x_new_with_version(&gen_reply);
+
+	/* Encode tuple header for {Tag, Reply} */
+	ei_x_encode_tuple_header(&gen_reply, 2);
+
+	/* Encode the tag (reference) */
+	ei_x_encode_ref(&gen_reply, tag_ref);
+
+	/* Append the reply data (which is already encoded in x) */
+	/* Note: x->buff may or may not have version byte, but we're appending the encoded data */
+	ei_x_append_buf(&gen_reply, x->buff, x->index);
+
+	/* Debug: Print hex dump of reply buffer */
+	printf("Godot CNode: Reply buffer (hex, first 64 bytes): ");
+	for (int i = 0; i < gen_reply.index && i < 64; i++) {
+		printf("%02x ", (unsigned char)gen_reply.buff[i]);
+	}
+	printf("\n");
+	fflush(stdout);
+
+	/* Connections served by process_cnode_frame send through their outbound queue */
+	if (queue_outbound_term(fd, to_pid, &gen_reply)) {
+		ei_x_free(&gen_reply);
+		return;
+	}
+
+	/* Send the GenServer-style reply to the From PID */
+	/* Use ei_send to send to a specific PID on the connected socket */
+	/* Format: ei_send(fd, pid, buf, len) */
+	/* Note: ei_send handles the distribution protocol automatically, but the buffer should be a valid BERT term */
+	/* The buffer should start with BERT version byte (0x83) which ei_x_new_with_version adds */
+	int send_result = ei_send(fd, to_pid, gen_reply.buff, gen_reply.index);
+	if (send_result < 0) {
+		fprintf(stderr, "Error sending reply (errno: %d, %s)\n", errno, strerror(errno));
+		fflush(stderr);
+	} else {
+		printf("Godot CNode: Reply sent successfully (GenServer format, %d bytes)\n", gen_reply.index);
+		/* Flush the socket to ensure reply is sent immediately */
+		fflush(stdout);
+		/* Give the socket more time to send the data and for client to receive */
+		usleep(100000); // 100ms - increased from 10ms
+	}
+
+	ei_x_free(&gen_reply);
+}
+
+/*
+ * Send a plain message (not a GenServer reply) to a PID, e.g. subscription updates
+ * x must have been created with ei_x_new_with_version
+ */
+static int send_message(int fd, erlang_pid *to_pid, ei_x_buff *x) {
+	if (fd < 0 || to_pid == nullptr || x == nullptr) {
+		return -1;
+	}
+	if (queue_outbound_term(fd, to_pid, x)) {
+		return 0;
+	}
+	int send_result = ei_send(fd, to_pid, x->buff, x->index);
+	if (send_result < 0) {
+		fprintf(stderr, "Godot CNode: Error sending message (errno: %d, %s)\n", errno, strerror(errno));
+		fflush(stderr);
+	}
+	return send_result;
+}
+
+/*
+ * Close a connection accepted by process_cnode_frame and drop state tied to it
+ */
+static void close_connection(int fd) {
+	close(fd);
+	CNodeServer *server = CNodeServer::get_singleton();
+	if (server != nullptr) {
+		server->connection_closed(fd);
+	}
+}
+
+/*
+ * Main loop - listen for messages from Erlang/Elixir
+ */
+extern "C" {
+void main_loop() {
+	ei_x_buff x;
+	erlang_msg msg;
+	int fd;
+	int res;
+
+	printf("Godot CNode: Entering main loop\n");
+
+	ei_x_new(&x);
+
+	/* Check if listen_fd is valid before entering loop */
+	if (listen_fd < 0) {
+		fprintf(stderr, "Godot CNode: Invalid listen_fd: %d, cannot accept connections\n", listen_fd);
+		return;
+	}
+
+	while (1) {
+		/* Check if listen_fd is still valid (might be closed during shutdown) */
+		if (listen_fd < 0) {
+			printf("Godot CNode: listen_fd closed, exiting main loop\n");
+			break;
+		}
+
+		/* Accept connection from Erlang/Elixir node */
+		/* Use blocking ei_accept - this is the standard way for CNode servers */
+		/* ei_accept() handles the Erlang distribution protocol handshake automatically */
+		/* Custom socket callbacks provide macOS-compatible accept implementation */
+
+		/* Use select() to wait for connection */
+		fd_set read_fds;
+		FD_ZERO(&read_fds);
+		FD_SET(listen_fd, &read_fds);
+		select(listen_fd + 1, &read_fds, NULL, NULL, NULL);
+
+		if (!FD_ISSET(listen_fd, &read_fds)) {
+			continue;
+		}
+
+		ErlConnect con;
+		fd = ei_accept(&ec, listen_fd, &con);
+
+		if (fd < 0) {
+			int saved_errno = errno;
+			fprintf(stderr, "Godot CNode: ei_accept() failed: %d (errno: %d, %s)\n", fd, saved_errno, strerror(saved_errno));
+
+			/* Handle specific error codes */
+			if (saved_errno == EBADF || saved_errno == 9) {
 				/* Bad file descriptor - socket was closed */
 				fprintf(stderr, "Godot CNode: listen_fd closed, exiting main loop\n");
 				break;
@@ -1363,784 +3277,2668 @@ void main_loop() {
 				printf("Godot CNode: ei_accept() interrupted, retrying...\n");
 				continue;
 			} else {
-				/* Other error - log details and retry after short delay */
-				fprintf(stderr, "Godot CNode: ei_accept() error (errno: %d, %s), retrying after 100ms...\n", saved_errno, strerror(saved_errno));
-				usleep(100000); // 100ms before retry
+				/* Other error - log details and retry after short delay */
+				fprintf(stderr, "Godot CNode: ei_accept() error (errno: %d, %s), retrying after 100ms...\n", saved_errno, strerror(saved_errno));
+				usleep(100000); // 100ms before retry
+				continue;
+			}
+		}
+
+		/* Log connection acceptance with timestamp for debugging */
+		struct timeval accept_time;
+		gettimeofday(&accept_time, NULL);
+		printf("Godot CNode: ✓ Accepted connection on fd: %d at %ld.%06d\n", fd, accept_time.tv_sec, accept_time.tv_usec);
+		fflush(stdout);
+		if (con.nodename[0] != '\0') {
+			printf("Godot CNode: Connected from node: %s\n", con.nodename);
+		} else {
+			printf("Godot CNode: Connected from node: (nodename not provided)\n");
+		}
+		fflush(stdout);
+
+		// Register global name "godot_server" so Erlang processes can send messages to it
+		// This must be done after accepting a connection (global names require a connection to an Erlang node)
+		// According to: https://www.erlang.org/doc/apps/erl_interface/ei_users_guide.html#using-global-names
+		static bool name_registered_main = false;
+		if (!name_registered_main) {
+			erlang_pid *self_pid = ei_self(&ec);
+			if (self_pid != nullptr && ei_global_register(fd, "godot_server", self_pid) == 0) {
+				printf("Godot CNode: ✓ Registered global name 'godot_server'\n");
+				fflush(stdout);
+				name_registered_main = true;
+			} else {
+				fprintf(stderr, "Godot CNode: Warning: Failed to register global name 'godot_server' (errno: %d, %s)\n", errno, strerror(errno));
+				fflush(stderr);
+			}
+		}
+
+		/* Receive message - use select() to wait for data before calling ei_receive_msg */
+		struct timeval wait_start;
+		gettimeofday(&wait_start, NULL);
+		printf("Godot CNode: Waiting to receive message from fd: %d at %ld.%06d...\n", fd, wait_start.tv_sec, wait_start.tv_usec);
+		fflush(stdout);
+
+		/* Wait for data to be available using select() */
+		fd_set recv_fds;
+		struct timeval recv_timeout;
+		FD_ZERO(&recv_fds);
+		FD_SET(fd, &recv_fds);
+		recv_timeout.tv_sec = 5; /* 5 second timeout */
+		recv_timeout.tv_usec = 0;
+		int select_res = select(fd + 1, &recv_fds, NULL, NULL, &recv_timeout);
+		bool data_available = (select_res > 0 && FD_ISSET(fd, &recv_fds));
+		if (data_available) {
+			/* Data is available, try to receive */
+			printf("Godot CNode: select() indicates data available, calling ei_receive_msg...\n");
+			fflush(stdout);
+			res = ei_receive_msg(fd, &msg, &x);
+			printf("Godot CNode: ei_receive_msg returned: %d", res);
+			fflush(stdout);
+		} else if (select_res == 0) {
+			/* Timeout - no data available */
+			printf("Godot CNode: select() timeout, no data available\n");
+			fflush(stdout);
+			ei_x_free(&x);
+			close(fd);
+			continue;
+		} else {
+			/* select() error */
+			printf("Godot CNode: select() error (errno: %d, %s)\n", errno, strerror(errno));
+			fflush(stdout);
+			ei_x_free(&x);
+			close(fd);
+			continue;
+		}
+
+		if (res == ERL_TICK) {
+			/* Just a tick, continue */
+			printf(" (ERL_TICK - keepalive)\n");
+			continue;
+		} else if (res == ERL_ERROR) {
+			int saved_errno = errno;
+			fprintf(stderr, " (ERL_ERROR - errno: %d, %s)\n", saved_errno, strerror(saved_errno));
+			/* macOS issue: errno 42 (Protocol not available) or errno 60 (Operation timed out) */
+			/* When ei_receive_msg fails, try raw read - the error might just mean ei_receive_msg couldn't decode it */
+			/* Note: errno 60 can occur even when data is available - ei_receive_msg just couldn't decode it */
+			if (saved_errno == 42 || saved_errno == ENOPROTOOPT || saved_errno == 60 || saved_errno == ETIMEDOUT) {
+				/* Try to process message from existing buffer if it has data */
+				printf("Godot CNode: Buffer index: %d, attempting to process message despite errno %d (data_available=%d)\n", x.index, saved_errno, data_available);
+				fflush(stdout);
+				if (x.index > 0) {
+					printf("Godot CNode: Attempting to process message from buffer (macOS compatibility, errno %d)\n", saved_errno);
+					fflush(stdout);
+					/* Process the message from buffer */
+					x.index = 0;
+					if (process_message(x.buff, &x.index, fd) < 0) {
+						fprintf(stderr, "Error processing message\n");
+					}
+					ei_x_free(&x);
+					close(fd);
+					continue;
+				} else {
+					/* Buffer is empty but ei_receive_msg failed - try raw read anyway */
+					/* Even if select() didn't indicate data, the error might mean there's data ei_receive_msg couldn't decode */
+					printf("Godot CNode: Buffer is empty but ei_receive_msg failed, trying raw read (errno %d)...\n", saved_errno);
+					fflush(stdout);
+					unsigned char raw_buf[4096];
+					ssize_t bytes_read = read(fd, raw_buf, sizeof(raw_buf));
+					if (bytes_read > 0) {
+						printf("Godot CNode: Raw read got %zd bytes, attempting to decode...\n", bytes_read);
+						fflush(stdout);
+
+						/* Convert raw data to base64 for inspection */
+						const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+						char base64_buf[8192]; /* Enough for 4096 bytes * 4/3 + padding */
+						int base64_len = 0;
+						for (ssize_t i = 0; i < bytes_read; i += 3) {
+							unsigned char b1 = raw_buf[i];
+							unsigned char b2 = (i + 1 < bytes_read) ? raw_buf[i + 1] : 0;
+							unsigned char b3 = (i + 2 < bytes_read) ? raw_buf[i + 2] : 0;
+
+							base64_buf[base64_len++] = base64_chars[(b1 >> 2) & 0x3F];
+							base64_buf[base64_len++] = base64_chars[((b1 << 4) | (b2 >> 4)) & 0x3F];
+							if (i + 1 < bytes_read) {
+								base64_buf[base64_len++] = base64_chars[((b2 << 2) | (b3 >> 6)) & 0x3F];
+							} else {
+								base64_buf[base64_len++] = '=';
+							}
+							if (i + 2 < bytes_read) {
+								base64_buf[base64_len++] = base64_chars[b3 & 0x3F];
+							} else {
+								base64_buf[base64_len++] = '=';
+							}
+						}
+						base64_buf[base64_len] = '\0';
+						printf("Godot CNode: Raw data (base64, FULL BUFFER): %s\n", base64_buf);
+						fflush(stdout);
+
+						/* Also print hex dump of first 64 bytes for inspection */
+						printf("Godot CNode: Raw data (hex, first 64 bytes): ");
+						for (ssize_t i = 0; i < bytes_read && i < 64; i++) {
+							printf("%02x ", raw_buf[i]);
+						}
+						printf("\n");
+						fflush(stdout);
+
+						/* Print full hex dump for debugging */
+						printf("Godot CNode: Raw data (hex, FULL BUFFER, %zd bytes):\n", bytes_read);
+						for (ssize_t i = 0; i < bytes_read; i++) {
+							if (i % 16 == 0) {
+								printf("%04zx: ", i);
+							}
+							printf("%02x ", raw_buf[i]);
+							if (i % 16 == 15 || i == bytes_read - 1) {
+								printf("\n");
+							}
+						}
+						fflush(stdout);
+
+						/* The raw data is in Erlang distribution protocol format */
+						/* Distribution protocol: [Length (4 bytes BE)] [Message Type] [Payload] */
+						/* We need to skip the length and message type to get to the BERT payload */
+						if (bytes_read >= 5) {
+							/* Distribution protocol SEND format: [4-byte BE length] [1-byte 'p'] [To Name] [Message] */
+							/* The "To Name" is encoded, then the actual BERT message follows */
+							/* We need to skip the "To Name" to get to the actual message */
+							int offset = 5; /* Skip header */
+
+							/* Try to find ALL messages in the buffer */
+							/* The distribution protocol format is: [4-byte length] [1-byte 'p'] [To Name] [Message] */
+							/* The "To Name" is encoded as an atom (starts with 0x83), then the actual message follows */
+							/* Look for pattern: 0x83 followed by 0x68 (small tuple) or 0x6B (large tuple) */
+							/* Find all occurrences and process each message */
+							printf("Godot CNode: Searching for all messages in buffer (size: %zd bytes, offset: %d)\n", bytes_read, offset);
+							fflush(stdout);
+
+							/* Find all 0x83 bytes that are followed by tuple markers */
+							int msg_starts[10]; /* Max 10 messages */
+							int msg_count = 0;
+							for (int i = offset; i < bytes_read - 2 && msg_count < 10; i++) {
+								if (raw_buf[i] == 0x83) {
+									/* Check if this is followed by a tuple marker (0x68 = small tuple, 0x6B = large tuple) */
+									if ((raw_buf[i + 1] == 0x68 || raw_buf[i + 1] == 0x6B)) {
+										msg_starts[msg_count] = i;
+										printf("Godot CNode: Found potential message at offset %d (hex: 0x%02x 0x%02x), message #%d\n",
+												i, raw_buf[i], raw_buf[i + 1], msg_count + 1);
+										fflush(stdout);
+										msg_count++;
+									}
+								}
+							}
+
+							printf("Godot CNode: Found %d potential message(s) in buffer\n", msg_count);
+							fflush(stdout);
+
+							/* Process each message found */
+							/* The first one (offset 5) is the "To Name" atom, skip it */
+							/* The rest are actual messages */
+							for (int msg_idx = 1; msg_idx < msg_count; msg_idx++) {
+								int msg_start = msg_starts[msg_idx];
+								printf("Godot CNode: Processing message #%d at offset %d\n", msg_idx, msg_start);
+								fflush(stdout);
+
+								/* Calculate payload length - from this message to end of buffer or next message */
+								int payload_len;
+								if (msg_idx + 1 < msg_count) {
+									/* Next message starts at msg_starts[msg_idx + 1] */
+									payload_len = msg_starts[msg_idx + 1] - msg_start;
+								} else {
+									/* Last message - goes to end of buffer */
+									payload_len = (int)bytes_read - msg_start;
+								}
+								printf("Godot CNode: Found message at offset %d, extracted %d bytes, attempting to decode...\n", msg_start, payload_len);
+								fflush(stdout);
+
+								/* Print hex of message start for debugging */
+								printf("Godot CNode: Message start (hex, first 32 bytes): ");
+								for (int i = 0; i < 32 && (msg_start + i) < bytes_read; i++) {
+									printf("%02x ", raw_buf[msg_start + i]);
+								}
+								printf("\n");
+								fflush(stdout);
+
+								/* The payload already has BERT version, so use it directly */
+								ei_x_buff raw_x;
+								ei_x_new(&raw_x); /* Don't add version, payload has it */
+								ei_x_append_buf(&raw_x, (const char *)&raw_buf[msg_start], payload_len);
+								raw_x.index = 0;
+
+								/* The message from distribution protocol is already a tuple, so we need to decode it */
+								/* Format: {'$gen_call', {From, Tag}, Request} or {rex, From, {'$gen_call', ...}} */
+								/* Skip version (already at index 0, which is the 0x83 byte) */
+								int msg_version;
+								printf("Godot CNode: Attempting to decode version, index before: %d, first byte: 0x%02x\n", raw_x.index, (unsigned char)raw_x.buff[raw_x.index]);
+								fflush(stdout);
+								if (ei_decode_version(raw_x.buff, &raw_x.index, &msg_version) < 0) {
+									fprintf(stderr, "Error: Could not decode BERT version from raw message (index: %d, first byte: 0x%02x)\n", raw_x.index, (unsigned char)raw_x.buff[0]);
+									fflush(stderr);
+									ei_x_free(&raw_x);
+									continue;
+								}
+								printf("Godot CNode: Decoded version: %d, index after: %d, next byte: 0x%02x\n", msg_version, raw_x.index, (unsigned char)raw_x.buff[raw_x.index]);
+								fflush(stdout);
+
+								/* Decode tuple header */
+								int tuple_arity;
+								printf("Godot CNode: Attempting to decode tuple header, index: %d, bytes: 0x%02x 0x%02x\n", raw_x.index, (unsigned char)raw_x.buff[raw_x.index], (unsigned char)raw_x.buff[raw_x.index + 1]);
+								fflush(stdout);
+								if (ei_decode_tuple_header(raw_x.buff, &raw_x.index, &tuple_arity) < 0) {
+									fprintf(stderr, "Error: Could not decode tuple header from raw message (index: %d)\n", raw_x.index);
+									fflush(stderr);
+									ei_x_free(&raw_x);
+									continue;
+								}
+								printf("Godot CNode: Decoded tuple arity: %d, index after: %d\n", tuple_arity, raw_x.index);
+								fflush(stdout);
+
+								/* Decode first atom to determine message type */
+								/* Check type first (this doesn't advance index) */
+								int atom_type, atom_size;
+								int atom_index = raw_x.index; /* Save position */
+								if (ei_get_type(raw_x.buff, &atom_index, &atom_type, &atom_size) < 0) {
+									fprintf(stderr, "Error: Could not get type at index %d\n", raw_x.index);
+									fflush(stderr);
+									ei_x_free(&raw_x);
+									continue;
+								}
+								printf("Godot CNode: Type at index %d: 0x%02x (size: %d), index after get_type: %d\n", raw_x.index, atom_type, atom_size, atom_index);
+								fflush(stdout);
+
+								char first_atom[MAXATOMLEN];
+								printf("Godot CNode: Attempting to decode atom, index: %d, bytes: 0x%02x 0x%02x 0x%02x\n", raw_x.index, (unsigned char)raw_x.buff[raw_x.index], (unsigned char)raw_x.buff[raw_x.index + 1], (unsigned char)raw_x.buff[raw_x.index + 2]);
+								fflush(stdout);
+
+								/* Decode atom - 0x6b is ATOM_UTF8_EXT (2-byte length) */
+								/* ei_decode_atom might not support UTF-8, try manual parse */
+								int decode_res;
+								if (atom_type == 0x6b) {
+									/* ATOM_UTF8_EXT: [0x6b] [len_high] [len_low] [utf8_bytes...] */
+									unsigned char len_high = raw_x.buff[raw_x.index + 1];
+									unsigned char len_low = raw_x.buff[raw_x.index + 2];
+									int atom_len = (len_high << 8) | len_low;
+									if (atom_len > 0 && atom_len < MAXATOMLEN) {
+										memcpy(first_atom, &raw_x.buff[raw_x.index + 3], atom_len);
+										first_atom[atom_len] = '\0';
+										raw_x.index += 3 + atom_len; /* Skip type + 2-byte len + data */
+										decode_res = 0;
+										printf("Godot CNode: Manually decoded UTF-8 atom: '%s' (len: %d)\n", first_atom, atom_len);
+										fflush(stdout);
+									} else {
+										decode_res = -1;
+									}
+								} else {
+									/* Try standard ei_decode_atom */
+									decode_res = ei_decode_atom(raw_x.buff, &raw_x.index, first_atom);
+								}
+
+								if (decode_res < 0) {
+									fprintf(stderr, "Error: Could not decode first atom from raw message (index: %d, type: 0x%02x, bytes: 0x%02x 0x%02x 0x%02x)\n", raw_x.index, atom_type, (unsigned char)raw_x.buff[raw_x.index], (unsigned char)raw_x.buff[raw_x.index + 1], (unsigned char)raw_x.buff[raw_x.index + 2]);
+									fflush(stderr);
+									ei_x_free(&raw_x);
+									continue;
+								}
+
+								printf("Godot CNode: Raw message - tuple arity: %d, first atom: %s\n", tuple_arity, first_atom);
+								fflush(stdout);
+
+								/* Now process based on message type */
+								if (strcmp(first_atom, "$gen_call") == 0) {
+									/* Direct gen_call: {'$gen_call', {From, Tag}, Request} */
+									printf("Godot CNode: Processing direct $gen_call from raw message\n");
+									fflush(stdout);
+									/* Decode {From, Tag} */
+									int from_arity;
+									if (ei_decode_tuple_header(raw_x.buff, &raw_x.index, &from_arity) < 0 || from_arity != 2) {
+										fprintf(stderr, "Error decoding From tuple in raw gen_call\n");
+										fflush(stderr);
+										ei_x_free(&raw_x);
+										continue;
+									}
+									erlang_pid from_pid;
+									erlang_ref tag_ref;
+									if (ei_decode_pid(raw_x.buff, &raw_x.index, &from_pid) < 0) {
+										fprintf(stderr, "Error decoding From PID in raw gen_call\n");
+										fflush(stderr);
+										ei_x_free(&raw_x);
+										continue;
+									}
+									if (ei_decode_ref(raw_x.buff, &raw_x.index, &tag_ref) < 0) {
+										fprintf(stderr, "Error decoding Tag in raw gen_call\n");
+										fflush(stderr);
+										ei_x_free(&raw_x);
+										continue;
+									}
+									/* Now handle the Request */
+									printf("Godot CNode: About to call handle_call for raw message (From PID: %s, Tag: %p)\n",
+											from_pid.node, (void *)&tag_ref);
+									fflush(stdout);
+									int call_result = handle_call(raw_x.buff, &raw_x.index, fd, &from_pid, &tag_ref);
+									if (call_result < 0) {
+										fprintf(stderr, "Error handling call from raw message\n");
+										fflush(stderr);
+									} else {
+										printf("Godot CNode: handle_call succeeded for raw message, reply should have been sent\n");
+										fflush(stdout);
+										/* GenServer call succeeded - give more time for reply to be sent and received */
+										usleep(200000); // 200ms - increased from 50ms
+									}
+								} else if (strcmp(first_atom, "rex") == 0) {
+									/* RPC wrapped: {rex, From, {'$gen_call', ...}} */
+									printf("Godot CNode: Processing rex message from raw message\n");
+									fflush(stdout);
+									/* Use process_message which handles rex format */
+									raw_x.index = 0; /* Reset to start */
+									int rex_result = process_message(raw_x.buff, &raw_x.index, fd);
+									if (rex_result < 0) {
+										fprintf(stderr, "Error processing rex message from raw read payload\n");
+										fflush(stderr);
+									} else {
+										/* GenServer call succeeded - give more time for reply to be sent and received */
+										usleep(200000); // 200ms - increased from 50ms
+									}
+								} else {
+									fprintf(stderr, "Error: Unknown message type in raw message: %s\n", first_atom);
+									fflush(stderr);
+								}
+
+								ei_x_free(&raw_x);
+								printf("Godot CNode: Finished processing message #%d\n", msg_idx);
+								fflush(stdout);
+							}
+
+							if (msg_count == 0) {
+								printf("Godot CNode: Could not find any messages (BERT version 0x83) in payload\n");
+								fflush(stdout);
+							} else if (msg_count == 1) {
+								printf("Godot CNode: Found only 'To Name', no actual messages in buffer\n");
+								fflush(stdout);
+							} else {
+								printf("Godot CNode: Processed %d message(s) from buffer (skipped 'To Name')\n", msg_count - 1);
+								fflush(stdout);
+							}
+						} else {
+							printf("Godot CNode: Raw data too short (%zd bytes), expected at least 5\n", bytes_read);
+							fflush(stdout);
+						}
+					} else {
+						printf("Godot CNode: Raw read failed (bytes_read: %zd, errno: %d)\n", bytes_read, errno);
+						fflush(stdout);
+					}
+				}
+			}
+			ei_x_free(&x);
+			/* Give additional time for reply to be fully transmitted before closing */
+			usleep(200000); // 200ms - increased from 100ms
+			close(fd);
+			continue;
+		} else {
+			struct timeval receive_time;
+			gettimeofday(&receive_time, NULL);
+			long elapsed_us = (receive_time.tv_sec - wait_start.tv_sec) * 1000000 + (receive_time.tv_usec - wait_start.tv_usec);
+			printf(" (success, elapsed: %ld us)\n", elapsed_us);
+		}
+
+		printf("Godot CNode: Message type: %ld\n", msg.msgtype);
+
+		/* Process the message */
+		x.index = 0;
+		int process_result = process_message(x.buff, &x.index, fd);
+		if (process_result < 0) {
+			fprintf(stderr, "Error processing message\n");
+		}
+
+		/* For GenServer calls, give time for reply to be sent */
+		if (process_result == 0) {
+			/* Longer delay to ensure reply is fully sent and received for GenServer calls */
+			usleep(200000); // 200ms - increased from 50ms
+		}
+
+		/* Process multiple messages on the same connection */
+		/* According to Erlang distribution protocol, multiple messages can be sent on the same connection */
+		/* Continue receiving messages until select() times out or connection closes */
+		printf("Godot CNode: Checking for more messages on this connection...\n");
+		fflush(stdout);
+
+		/* Free the current buffer and prepare for next message */
+		ei_x_free(&x);
+		ei_x_new(&x);
+
+		/* Check if more data is available with a short timeout */
+		FD_ZERO(&recv_fds);
+		FD_SET(fd, &recv_fds);
+		recv_timeout.tv_sec = 0; /* No wait - check immediately */
+		recv_timeout.tv_usec = 100000; /* 100ms */
+		select_res = select(fd + 1, &recv_fds, NULL, NULL, &recv_timeout);
+		if (select_res > 0 && FD_ISSET(fd, &recv_fds)) {
+			/* More data available - continue processing */
+			printf("Godot CNode: More data available, continuing to receive...\n");
+			fflush(stdout);
+			continue; /* Go back to receive next message */
+		} else {
+			/* No more data - close connection */
+			printf("Godot CNode: No more data available, closing connection\n");
+			fflush(stdout);
+			ei_x_free(&x);
+			close(fd);
+		}
+	}
+
+	ei_x_free(&x);
+}
+} // extern "C" - closes main_loop's extern "C" block
+
+/*
+ * Helper: Pick the scheduler lane of a received message - GenServer calls (also rex-wrapped) or casts
+ */
+static CNodePeerScheduler::Lane classify_message(const char *buf) {
+	int index = 0;
+	int version;
+	int arity;
+	char atom[MAXATOMLEN];
+	if (ei_decode_version(buf, &index, &version) < 0) {
+		index = 0;
+	}
+	if (ei_decode_tuple_header(buf, &index, &arity) < 0 || ei_decode_atom(buf, &index, atom) < 0) {
+		return CNodePeerScheduler::LANE_CAST;
+	}
+	return strcmp(atom, "$gen_call") == 0 || strcmp(atom, "rex") == 0 ? CNodePeerScheduler::LANE_CALL : CNodePeerScheduler::LANE_CAST;
+}
+
+/*
+ * Helper: Decode {From, Tag} of a received $gen_call message, also when rex-wrapped
+ */
+static bool decode_call_target(const char *buf, erlang_pid *r_pid, erlang_ref *r_tag) {
+	int index = 0;
+	int version;
+	int arity;
+	char atom[MAXATOMLEN];
+	if (ei_decode_version(buf, &index, &version) < 0) {
+		index = 0;
+	}
+	if (ei_decode_tuple_header(buf, &index, &arity) < 0 || ei_decode_atom(buf, &index, atom) < 0) {
+		return false;
+	}
+	if (strcmp(atom, "rex") == 0) {
+		erlang_pid rpc_from_pid;
+		if (ei_decode_pid(buf, &index, &rpc_from_pid) < 0 || ei_decode_tuple_header(buf, &index, &arity) < 0 ||
+				ei_decode_atom(buf, &index, atom) < 0) {
+			return false;
+		}
+	}
+	if (strcmp(atom, "$gen_call") != 0) {
+		return false;
+	}
+	return ei_decode_tuple_header(buf, &index, &arity) == 0 && arity == 2 &&
+			ei_decode_pid(buf, &index, r_pid) == 0 && ei_decode_ref(buf, &index, r_tag) == 0;
+}
+
+/*
+ * Helper: Accept a pending connection and register it with the scheduler
+ */
+static void accept_peer(CNodeServer *server) {
+	ErlConnect con;
+	int fd = ei_accept(&ec, listen_fd, &con);
+	if (fd < 0) {
+		// Not critical, the listen socket stays readable and is retried next pass
+		return;
+	}
+
+	printf("Godot CNode: ✓ Accepted connection on fd: %d\n", fd);
+	if (con.nodename[0] != '\0') {
+		printf("Godot CNode: Connected from node: %s\n", con.nodename);
+	}
+	fflush(stdout);
+
+	// Register global name "godot_server" so Erlang processes can send messages to it
+	// This must be done after accepting a connection (global names require a connection to an Erlang node)
+	// According to: https://www.erlang.org/doc/apps/erl_interface/ei_users_guide.html#using-global-names
+	static bool name_registered = false;
+	if (!name_registered) {
+		erlang_pid *self_pid = ei_self(&ec);
+		if (self_pid != nullptr && ei_global_register(fd, "godot_server", self_pid) == 0) {
+			printf("Godot CNode: ✓ Registered global name 'godot_server'\n");
+			fflush(stdout);
+			name_registered = true;
+		} else {
+			fprintf(stderr, "Godot CNode: Warning: Failed to register global name 'godot_server' (errno: %d, %s)\n", errno, strerror(errno));
+			fflush(stderr);
+		}
+	}
+
+	String node_name = String::utf8(con.nodename);
+	server->get_scheduler().add_peer(fd, server->get_peer_weight(node_name));
+}
+
+/*
+ * Helper: Read one message from a readable connection into its scheduler lane
+ */
+static void receive_from_peer(CNodeServer *server, int fd, ei_x_buff *x, erlang_msg *msg) {
+	x->index = 0;
+	int res = ei_receive_msg(fd, msg, x);
+	if (res == ERL_TICK) {
+		return; // Keepalive only
+	}
+	if (res == ERL_ERROR) {
+		int saved_errno = errno;
+		// macOS compatibility - the message may still be complete in the buffer
+		bool buffered = (saved_errno == 42 || saved_errno == ENOPROTOOPT) && x->index > 0;
+		if (!buffered) {
+			// Connection closed or error
+			close_connection(fd);
+			return;
+		}
+	}
+
+	CNodePeerScheduler::Lane lane = server->is_split_lanes() ? classify_message(x->buff) : CNodePeerScheduler::LANE_CALL;
+	server->get_scheduler().enqueue(fd, lane, x->buff, x->index, Time::get_singleton()->get_ticks_usec());
+}
+
+/*
+ * Non-blocking version of main_loop for use in Godot's main thread
+ * Accepts new connections, reads at most one message per readable connection into the
+ * scheduler and dispatches the message it picks next, returning immediately if there is none
+ * Returns: 0 = processed something, 1 = nothing to process, -1 = error/shutdown
+ */
+extern "C" {
+int process_cnode_frame(void) {
+	static ei_x_buff x;
+	static erlang_msg msg;
+	static bool x_initialized = false;
+
+	// Initialize buffer on first call
+	if (!x_initialized) {
+		ei_x_new(&x);
+		x_initialized = true;
+	}
+
+	// Check if listen_fd is valid
+	CNodeServer *server = CNodeServer::get_singleton();
+	if (listen_fd < 0 || server == nullptr) {
+		return -1; // Shutdown
+	}
+
+	// One select over the listen socket and every connection, zero timeout = non-blocking
+	fd_set read_fds;
+	struct timeval timeout;
+	FD_ZERO(&read_fds);
+	FD_SET(listen_fd, &read_fds);
+	int max_fd = listen_fd;
+	CNodePeerScheduler &scheduler = server->get_scheduler();
+	LocalVector<int> peer_fds = scheduler.get_peer_fds(); // Copy, reads may close connections
+	for (uint32_t i = 0; i < peer_fds.size(); i++) {
+		flush_outbound(scheduler, peer_fds[i]);
+		// Backpressure: leave a full connection unread until its queues drain. A connection with a
+		// frame partly written is not read either, since ei answers ticks by writing to the socket
+		if (scheduler.is_inbound_full(peer_fds[i]) || scheduler.is_outbound_full(peer_fds[i]) || scheduler.is_writing(peer_fds[i])) {
+			continue;
+		}
+		FD_SET(peer_fds[i], &read_fds);
+		max_fd = MAX(max_fd, peer_fds[i]);
+	}
+	timeout.tv_sec = 0;
+	timeout.tv_usec = 0;
+
+	int select_res = select(max_fd + 1, &read_fds, NULL, NULL, &timeout);
+	if (select_res < 0 && errno == EBADF) {
+		// A closed listen socket means shutdown, a bad connection is dropped
+		if (fcntl(listen_fd, F_GETFD) < 0) {
+			return -1;
+		}
+		for (uint32_t i = 0; i < peer_fds.size(); i++) {
+			if (fcntl(peer_fds[i], F_GETFD) < 0) {
+				close_connection(peer_fds[i]);
+			}
+		}
+	}
+	if (select_res > 0) {
+		for (uint32_t i = 0; i < peer_fds.size(); i++) {
+			if (FD_ISSET(peer_fds[i], &read_fds)) {
+				receive_from_peer(server, peer_fds[i], &x, &msg);
+			}
+		}
+		if (FD_ISSET(listen_fd, &read_fds)) {
+			accept_peer(server);
+		}
+	}
+
+	CNodePeerScheduler::Message message;
+	if (!scheduler.next(message)) {
+		return 1; // Nothing to process this frame
+	}
+	int index = 0;
+	int process_result = process_message((char *)message.data.ptrw(), &index, message.fd, message.received_usec);
+	if (process_result < 0) {
+		// A malformed request only costs its own connection, the others keep being served
+		close_connection(message.fd);
+	}
+	return 0; // Processed message
+}
+} // extern "C"
+
+// CNodeServer Node class implementation
+namespace godot {
+
+CNodeTimerWheel::CNodeTimerWheel() : last_frame(0), started(false), count(0) {
+}
+
+uint32_t CNodeObjectHandles::get_handle(Object *object) {
+	uint64_t id = object->get_instance_id();
+	const uint32_t *existing = slot_by_object.getptr(id);
+	if (existing != nullptr) {
+		return (slots[*existing].generation << INDEX_BITS) | (*existing + 1);
+	}
+
+	uint32_t slot;
+	if (!free_slots.is_empty()) {
+		slot = free_slots[free_slots.size() - 1];
+		free_slots.remove_at(free_slots.size() - 1);
+	} else if (slots.size() < INDEX_MASK) {
+		slot = slots.size();
+		Slot fresh;
+		fresh.object = nullptr;
+		fresh.generation = 0;
+		slots.push_back(fresh);
+	} else {
+		return 0;
+	}
+	slots[slot].object = object;
+	slot_by_object.insert(id, slot);
+
+	// One sentinel per object serves every table
+	static const StringName sentinel_meta = "_cnode_handle_sentinel";
+	if (!object->has_meta(sentinel_meta)) {
+		Ref<CNodeHandleSentinel> sentinel;
+		sentinel.instantiate();
+		sentinel->target = ObjectID(id);
+		object->set_meta(sentinel_meta, sentinel);
+	}
+	return (slots[slot].generation << INDEX_BITS) | (slot + 1);
+}
+
+Object *CNodeObjectHandles::lookup(uint32_t handle) const {
+	uint32_t slot = (handle & INDEX_MASK) - 1;
+	if ((handle & INDEX_MASK) == 0 || slot >= slots.size()) {
+		return nullptr;
+	}
+	const Slot &entry = slots[slot];
+	return entry.generation == (handle >> INDEX_BITS) ? entry.object : nullptr;
+}
+
+void CNodeObjectHandles::invalidate(ObjectID id) {
+	const uint32_t *slot = slot_by_object.getptr((uint64_t)id);
+	if (slot == nullptr) {
+		return;
+	}
+	// Bumping the generation makes every handle already sent for this slot stale
+	Slot &entry = slots[*slot];
+	entry.object = nullptr;
+	entry.generation = (entry.generation + 1) & GENERATION_MASK;
+	free_slots.push_back(*slot);
+	slot_by_object.erase((uint64_t)id);
+}
+
+CNodeHandleSentinel::~CNodeHandleSentinel() {
+	CNodeServer *server = CNodeServer::get_singleton();
+	if (server != nullptr) {
+		server->object_freed(target);
+	}
+}
+
+static void encode_string_list(const PackedStringArray &names, ei_x_buff *x) {
+	ei_x_encode_list_header(x, names.size());
+	for (int64_t i = 0; i < names.size(); i++) {
+		ei_x_encode_string(x, names[i].utf8().get_data());
+	}
+	ei_x_encode_empty_list(x);
+}
+
+// Snapshot file layout: header, one ClassSnapshotEntry per class, then the blobs they point at
+static const char CLASS_SNAPSHOT_MAGIC[4] = { 'C', 'N', 'C', 'M' };
+static const uint32_t CLASS_SNAPSHOT_FORMAT = 1;
+static const char *CLASS_SNAPSHOT_PATH = "user://cnode_classdb.bin";
+
+struct ClassSnapshotHeader {
+	char magic[4];
+	uint32_t format;
+	uint64_t hash;
+	uint32_t class_count;
+	uint32_t class_list_offset;
+	uint32_t class_list_size;
+	uint32_t singleton_list_offset;
+	uint32_t singleton_list_size;
+	uint32_t reserved;
+};
+
+struct ClassSnapshotEntry {
+	uint32_t name_offset;
+	uint32_t name_size;
+	uint32_t section_offset[CNodeClassMetadata::SECTION_MAX];
+	uint32_t section_size[CNodeClassMetadata::SECTION_MAX];
+};
+
+/* Helper: Whether offset + size lies within a snapshot image (and fits a Blob) */
+static bool image_range_valid(uint32_t offset, uint32_t size, size_t image_size) {
+	return size <= INT32_MAX && (size_t)offset + size <= image_size;
+}
+
+/* Helper: Append bytes to a snapshot image, returns their offset */
+static uint32_t append_image(LocalVector<char> &r_image, const char *data, uint32_t size) {
+	uint32_t offset = r_image.size();
+	r_image.resize(offset + size);
+	memcpy(r_image.ptr() + offset, data, size);
+	return offset;
+}
+
+/* Helper: Append an encoded term to a snapshot image and reset the buffer */
+static void append_image_term(LocalVector<char> &r_image, ei_x_buff *x, uint32_t &r_offset, uint32_t &r_size) {
+	r_offset = append_image(r_image, x->buff, x->index);
+	r_size = x->index;
+	x->index = 0;
+}
+
+static uint64_t fnv1a_64(uint64_t hash, const CharString &text) {
+	for (int64_t i = 0; i < text.length(); i++) {
+		hash ^= (uint8_t)text.get_data()[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+uint64_t CNodeClassMetadata::compute_hash() {
+	uint64_t hash = 14695981039346656037ULL;
+	hash = fnv1a_64(hash, String(Variant(Engine::get_singleton()->get_version_info())).utf8());
+	PackedStringArray extensions = GDExtensionManager::get_singleton()->get_loaded_extensions();
+	for (int64_t i = 0; i < extensions.size(); i++) {
+		hash = fnv1a_64(hash, extensions[i].utf8());
+	}
+	// A rebuilt extension keeps its path, so the class names are part of the key as well
+	PackedStringArray class_names = ClassDBSingleton::get_singleton()->get_class_list();
+	for (int64_t i = 0; i < class_names.size(); i++) {
+		hash = fnv1a_64(hash, class_names[i].utf8());
+	}
+	return hash ^ CLASS_SNAPSHOT_FORMAT;
+}
+
+CNodeClassMetadata::~CNodeClassMetadata() {
+	_release();
+}
+
+void CNodeClassMetadata::_release() {
+#ifndef _WIN32
+	if (mapping != nullptr) {
+		munmap(mapping, image_size);
+	}
+#endif
+	mapping = nullptr;
+	owned_image.clear();
+	image = nullptr;
+	image_size = 0;
+	class_index.clear();
+}
+
+bool CNodeClassMetadata::_attach(const char *data, size_t size, uint64_t hash) {
+	if (size < sizeof(ClassSnapshotHeader)) {
+		return false;
+	}
+	ClassSnapshotHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, CLASS_SNAPSHOT_MAGIC, 4) != 0 || header.format != CLASS_SNAPSHOT_FORMAT || header.hash != hash ||
+			sizeof(header) + (size_t)header.class_count * sizeof(ClassSnapshotEntry) > size ||
+			!image_range_valid(header.class_list_offset, header.class_list_size, size) ||
+			!image_range_valid(header.singleton_list_offset, header.singleton_list_size, size)) {
+		return false;
+	}
+
+	// Every range is checked once here, so lookups can use the image as is
+	class_index.clear();
+	const char *entries = data + sizeof(header);
+	for (uint32_t i = 0; i < header.class_count; i++) {
+		ClassSnapshotEntry entry;
+		memcpy(&entry, entries + i * sizeof(entry), sizeof(entry));
+		bool valid = image_range_valid(entry.name_offset, entry.name_size, size);
+		for (int section = 0; valid && section < SECTION_MAX; section++) {
+			valid = image_range_valid(entry.section_offset[section], entry.section_size[section], size);
+		}
+		if (!valid) {
+			class_index.clear();
+			return false;
+		}
+		class_index.insert(String::utf8(data + entry.name_offset, entry.name_size), i);
+	}
+	image = data;
+	image_size = size;
+	return true;
+}
+
+bool CNodeClassMetadata::map_snapshot(const String &path, uint64_t hash) {
+#ifndef _WIN32
+	CharString file_path = ProjectSettings::get_singleton()->globalize_path(path).utf8();
+	int fd = open(file_path.get_data(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat info;
+	void *data = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && info.st_size > 0) {
+		data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd); // The mapping stays valid
+	if (data == MAP_FAILED) {
+		return false;
+	}
+
+	_release();
+	if (!_attach((const char *)data, info.st_size, hash)) {
+		munmap(data, info.st_size);
+		return false;
+	}
+	mapping = data;
+	return true;
+#else
+	return false; // Snapshots are rebuilt in memory on Windows
+#endif
+}
+
+void CNodeClassMetadata::build_snapshot(const String &path, uint64_t hash) {
+	ClassDBSingleton *class_db = ClassDBSingleton::get_singleton();
+	PackedStringArray class_names = class_db->get_class_list();
+
+	ClassSnapshotHeader header;
+	memcpy(header.magic, CLASS_SNAPSHOT_MAGIC, 4);
+	header.format = CLASS_SNAPSHOT_FORMAT;
+	header.hash = hash;
+	header.class_count = class_names.size();
+	header.reserved = 0;
+
+	LocalVector<char> data;
+	LocalVector<ClassSnapshotEntry> entries;
+	entries.resize(class_names.size());
+	uint32_t data_start = sizeof(header) + entries.size() * sizeof(ClassSnapshotEntry);
+	data.resize(data_start);
+
+	ei_x_buff x;
+	ei_x_new(&x);
+	encode_string_list(class_names, &x);
+	append_image_term(data, &x, header.class_list_offset, header.class_list_size);
+	encode_string_list(Engine::get_singleton()->get_singleton_list(), &x);
+	append_image_term(data, &x, header.singleton_list_offset, header.singleton_list_size);
+
+	for (int64_t c = 0; c < class_names.size(); c++) {
+		const String &class_name = class_names[c];
+		ClassSnapshotEntry &entry = entries[c];
+		CharString name = class_name.utf8();
+		entry.name_offset = append_image(data, name.get_data(), name.length());
+		entry.name_size = name.length();
+
+		// [{Name, ReturnType, [{ArgName, ArgType}], Flags}]
+		TypedArray<Dictionary> methods = class_db->class_get_method_list(class_name);
+		ei_x_encode_list_header(&x, methods.size());
+		for (int64_t i = 0; i < methods.size(); i++) {
+			encode_method_info(methods[i], &x);
+		}
+		ei_x_encode_empty_list(&x);
+		append_image_term(data, &x, entry.section_offset[SECTION_METHODS], entry.section_size[SECTION_METHODS]);
+
+		// [{Name, Type, ClassName}]
+		TypedArray<Dictionary> properties = class_db->class_get_property_list(class_name);
+		ei_x_encode_list_header(&x, properties.size());
+		for (int64_t i = 0; i < properties.size(); i++) {
+			encode_property_info(properties[i], &x);
+		}
+		ei_x_encode_empty_list(&x);
+		append_image_term(data, &x, entry.section_offset[SECTION_PROPERTIES], entry.section_size[SECTION_PROPERTIES]);
+
+		// [{Name, [{ArgName, ArgType}]}]
+		TypedArray<Dictionary> signals = class_db->class_get_signal_list(class_name);
+		ei_x_encode_list_header(&x, signals.size());
+		for (int64_t i = 0; i < signals.size(); i++) {
+			Dictionary signal = signals[i];
+			Array signal_args = signal["args"];
+			ei_x_encode_tuple_header(&x, 2);
+			ei_x_encode_string(&x, signal["name"].operator String().utf8().get_data());
+			ei_x_encode_list_header(&x, signal_args.size());
+			for (int64_t j = 0; j < signal_args.size(); j++) {
+				Dictionary arg = signal_args[j];
+				ei_x_encode_tuple_header(&x, 2);
+				ei_x_encode_string(&x, arg["name"].operator String().utf8().get_data());
+				ei_x_encode_long(&x, (long)(int64_t)arg["type"]);
+			}
+			ei_x_encode_empty_list(&x);
+		}
+		ei_x_encode_empty_list(&x);
+		append_image_term(data, &x, entry.section_offset[SECTION_SIGNALS], entry.section_size[SECTION_SIGNALS]);
+
+		// [{EnumName, [{Constant, Value}]}]
+		PackedStringArray enums = class_db->class_get_enum_list(class_name);
+		ei_x_encode_list_header(&x, enums.size());
+		for (int64_t i = 0; i < enums.size(); i++) {
+			PackedStringArray constants = class_db->class_get_enum_constants(class_name, enums[i]);
+			ei_x_encode_tuple_header(&x, 2);
+			ei_x_encode_string(&x, enums[i].utf8().get_data());
+			ei_x_encode_list_header(&x, constants.size());
+			for (int64_t j = 0; j < constants.size(); j++) {
+				ei_x_encode_tuple_header(&x, 2);
+				ei_x_encode_string(&x, constants[j].utf8().get_data());
+				ei_x_encode_longlong(&x, class_db->class_get_integer_constant(class_name, constants[j]));
+			}
+			ei_x_encode_empty_list(&x);
+		}
+		ei_x_encode_empty_list(&x);
+		append_image_term(data, &x, entry.section_offset[SECTION_ENUMS], entry.section_size[SECTION_ENUMS]);
+	}
+	ei_x_free(&x);
+
+	memcpy(data.ptr(), &header, sizeof(header));
+	if (!entries.is_empty()) {
+		memcpy(data.ptr() + sizeof(header), entries.ptr(), entries.size() * sizeof(ClassSnapshotEntry));
+	}
+
+	// Write to a temporary file first so a crash never leaves a truncated snapshot behind
+	CharString file_path = ProjectSettings::get_singleton()->globalize_path(path).utf8();
+	CharString temp_path = (String::utf8(file_path.get_data()) + ".tmp").utf8();
+	FILE *file = fopen(temp_path.get_data(), "wb");
+	bool written = file != nullptr && fwrite(data.ptr(), 1, data.size(), file) == data.size();
+	if (file != nullptr) {
+		written = fclose(file) == 0 && written;
+	}
+	if (written && rename(temp_path.get_data(), file_path.get_data()) == 0 && map_snapshot(path, hash)) {
+		return;
+	}
+	fprintf(stderr, "Godot CNode: Could not persist ClassDB snapshot to %s, keeping it in memory\n", file_path.get_data());
+
+	_release();
+	owned_image = data;
+	_attach(owned_image.ptr(), owned_image.size(), hash);
+}
+
+CNodeClassMetadata::Blob CNodeClassMetadata::get_class_list() const {
+	Blob blob;
+	if (image != nullptr) {
+		ClassSnapshotHeader header;
+		memcpy(&header, image, sizeof(header));
+		blob.data = image + header.class_list_offset;
+		blob.size = header.class_list_size;
+	}
+	return blob;
+}
+
+CNodeClassMetadata::Blob CNodeClassMetadata::get_singleton_list() const {
+	Blob blob;
+	if (image != nullptr) {
+		ClassSnapshotHeader header;
+		memcpy(&header, image, sizeof(header));
+		blob.data = image + header.singleton_list_offset;
+		blob.size = header.singleton_list_size;
+	}
+	return blob;
+}
+
+bool CNodeClassMetadata::get_class_section(const String &class_name, Section section, Blob &r_blob) const {
+	const uint32_t *index = class_index.getptr(class_name);
+	if (index == nullptr) {
+		return false;
+	}
+	ClassSnapshotEntry entry;
+	memcpy(&entry, image + sizeof(ClassSnapshotHeader) + *index * sizeof(entry), sizeof(entry));
+	r_blob.data = image + entry.section_offset[section];
+	r_blob.size = entry.section_size[section];
+	return true;
+}
+
+void CNodeTimerWheel::schedule(uint64_t target_frame, const char *term, int term_len, int fd, const CNodeReplyTarget *reply_to) {
+	// Overdue entries run on the next collected frame instead of waiting a full revolution
+	if (started && target_frame <= last_frame) {
+		target_frame = last_frame + 1;
+	}
+	LocalVector<Entry> &slot = slots[target_frame % SLOT_COUNT];
+	slot.resize(slot.size() + 1);
+	Entry &entry = slot[slot.size() - 1];
+	entry.target_frame = target_frame;
+	entry.fd = fd;
+	entry.received_usec = current_request_received_usec;
+	entry.has_reply = reply_to != nullptr;
+	if (reply_to != nullptr) {
+		entry.reply_to = *reply_to;
+	}
+	entry.request.resize(term_len);
+	memcpy(entry.request.ptr(), term, term_len);
+	count++;
+}
+
+void CNodeTimerWheel::collect_due(uint64_t frame, LocalVector<Entry> &r_due) {
+	if (started && frame <= last_frame) {
+		return;
+	}
+	// Normally one frame elapses per call; sweep the skipped slots otherwise (at most one revolution)
+	uint64_t first = started ? last_frame + 1 : 0;
+	if (frame - first >= SLOT_COUNT) {
+		first = frame - (SLOT_COUNT - 1);
+	}
+	started = true;
+	last_frame = frame;
+
+	for (uint64_t f = first; count > 0 && f <= frame; f++) {
+		LocalVector<Entry> &slot = slots[f % SLOT_COUNT];
+		for (uint32_t i = 0; i < slot.size();) {
+			if (slot[i].target_frame <= frame) {
+				r_due.push_back(slot[i]);
+				slot.remove_at(i); // Keep scheduling order within the slot
+				count--;
+			} else {
+				i++;
+			}
+		}
+	}
+}
+
+void CNodeTimerWheel::cancel(const erlang_ref &tag, LocalVector<Entry> &r_cancelled) {
+	for (int s = 0; s < SLOT_COUNT && count > 0; s++) {
+		LocalVector<Entry> &slot = slots[s];
+		for (uint32_t i = 0; i < slot.size();) {
+			if (slot[i].has_reply && same_ref(slot[i].reply_to.tag, tag)) {
+				r_cancelled.push_back(slot[i]);
+				slot.remove_at(i);
+				count--;
+			} else {
+				i++;
+			}
+		}
+	}
+}
+
+void CNodePeerScheduler::set_limits(int p_inbound_max_messages, int64_t p_inbound_max_bytes, int64_t p_outbound_max_bytes) {
+	inbound_max_messages = p_inbound_max_messages;
+	inbound_max_bytes = p_inbound_max_bytes;
+	outbound_max_bytes = p_outbound_max_bytes;
+}
+
+void CNodePeerScheduler::add_peer(int fd, int weight) {
+	remove_peer(fd); // A reused descriptor starts from scratch
+	peer_fds.push_back(fd);
+	peers.insert(fd, Peer());
+	for (int lane = 0; lane < LANE_MAX; lane++) {
+		Flow flow;
+		flow.weight = MAX(1, weight);
+		flows.insert(flow_key(fd, (Lane)lane), flow);
+	}
+}
+
+void CNodePeerScheduler::remove_peer(int fd) {
+	for (int lane = 0; lane < LANE_MAX; lane++) {
+		uint64_t key = flow_key(fd, (Lane)lane);
+		Flow *flow = flows.getptr(key);
+		if (flow != nullptr) {
+			queued -= flow->queue.size() - flow->head;
+			flows.erase(key);
+		}
+		for (uint32_t i = 0; i < active.size();) {
+			if (active[i] == key) {
+				active.remove_at(i);
+				if (cursor > i) {
+					cursor--;
+				}
+			} else {
+				i++;
+			}
+		}
+	}
+	peers.erase(fd);
+	peer_fds.erase(fd);
+}
+
+void CNodePeerScheduler::enqueue(int fd, Lane lane, const char *data, int size, uint64_t received_usec) {
+	uint64_t key = flow_key(fd, lane);
+	Flow *flow = flows.getptr(key);
+	Peer *peer = peers.getptr(fd);
+	if (flow == nullptr || peer == nullptr || size <= 0) {
+		return;
+	}
+	Message message;
+	message.fd = fd;
+	message.data.resize(size);
+	memcpy(message.data.ptrw(), data, size);
+	message.received_usec = received_usec;
+	flow->queue.push_back(message);
+	queued++;
+	peer->queued++;
+	peer->queued_bytes += size;
+	inbound_high_water = MAX(inbound_high_water, peer->queued);
+	inbound_high_water_bytes = MAX(inbound_high_water_bytes, peer->queued_bytes);
+	if (!flow->active) {
+		flow->active = true;
+		active.push_back(key);
+	}
+}
+
+bool CNodePeerScheduler::next(Message &r_message) {
+	while (!active.is_empty()) {
+		if (cursor >= active.size()) {
+			cursor = 0;
+		}
+		Flow *flow = flows.getptr(active[cursor]);
+		if (flow->head >= flow->queue.size()) {
+			// An emptied lane leaves the round and does not bank credit while idle
+			flow->queue.clear();
+			flow->head = 0;
+			flow->deficit = 0;
+			flow->credited = false;
+			flow->active = false;
+			active.remove_at(cursor);
+			continue;
+		}
+		if (!flow->credited) {
+			flow->deficit += (int64_t)flow->weight * QUANTUM_BYTES;
+			flow->credited = true;
+		}
+		Message &head = flow->queue[flow->head];
+		if (head.data.size() > flow->deficit) {
+			// Not enough credit left on this visit, move on and keep the rest for the next round
+			flow->credited = false;
+			cursor++;
+			continue;
+		}
+
+		flow->deficit -= head.data.size();
+		Peer *peer = peers.getptr(head.fd);
+		peer->queued--;
+		peer->queued_bytes -= head.data.size();
+		r_message = head;
+		head.data = PackedByteArray();
+		flow->head++;
+		queued--;
+		// Drop the dispatched prefix once it dominates the queue
+		if (flow->head >= 64 && flow->head * 2 >= flow->queue.size()) {
+			LocalVector<Message> rest;
+			rest.reserve(flow->queue.size() - flow->head);
+			for (uint32_t i = flow->head; i < flow->queue.size(); i++) {
+				rest.push_back(flow->queue[i]);
+			}
+			flow->queue = rest;
+			flow->head = 0;
+		}
+		return true;
+	}
+	return false;
+}
+
+void CNodePeerScheduler::remove_calls(const erlang_ref &tag, LocalVector<CNodeReplyTarget> &r_removed) {
+	for (KeyValue<uint64_t, Flow> &E : flows) {
+		if ((E.key & 1) != LANE_CALL) {
+			continue;
+		}
+		Flow &flow = E.value;
+		for (uint32_t i = flow.head; i < flow.queue.size();) {
+			Message &message = flow.queue[i];
+			CNodeReplyTarget target;
+			if (!decode_call_target((const char *)message.data.ptr(), &target.pid, &target.tag) || !same_ref(target.tag, tag)) {
+				i++;
 				continue;
 			}
+			target.fd = message.fd;
+			r_removed.push_back(target);
+			Peer *peer = peers.getptr(message.fd);
+			peer->queued--;
+			peer->queued_bytes -= message.data.size();
+			queued--;
+			flow.queue.remove_at(i); // Keep arrival order
 		}
+	}
+}
 
-		/* Log connection acceptance with timestamp for debugging */
-		struct timeval accept_time;
-		gettimeofday(&accept_time, NULL);
-		printf("Godot CNode: ✓ Accepted connection on fd: %d at %ld.%06d\n", fd, accept_time.tv_sec, accept_time.tv_usec);
-		fflush(stdout);
-		if (con.nodename[0] != '\0') {
-			printf("Godot CNode: Connected from node: %s\n", con.nodename);
+bool CNodePeerScheduler::is_inbound_full(int fd) const {
+	const Peer *peer = peers.getptr(fd);
+	return peer != nullptr && (peer->queued >= inbound_max_messages || peer->queued_bytes >= inbound_max_bytes);
+}
+
+bool CNodePeerScheduler::is_outbound_full(int fd) const {
+	const Peer *peer = peers.getptr(fd);
+	return peer != nullptr && peer->outbox_bytes >= outbound_max_bytes;
+}
+
+bool CNodePeerScheduler::queue_outbound(int fd, const PackedByteArray &frame) {
+	Peer *peer = peers.getptr(fd);
+	if (peer == nullptr) {
+		return false;
+	}
+	Outgoing outgoing;
+	outgoing.frame = frame;
+	peer->outbox.push_back(outgoing);
+	peer->outbox_bytes += frame.size();
+	outbound_high_water_bytes = MAX(outbound_high_water_bytes, peer->outbox_bytes);
+	return true;
+}
+
+bool CNodePeerScheduler::peek_outbound(int fd, const uint8_t *&r_data, int64_t &r_size) const {
+	const Peer *peer = peers.getptr(fd);
+	if (peer == nullptr || peer->outbox_head >= peer->outbox.size()) {
+		return false;
+	}
+	const PackedByteArray &frame = peer->outbox[peer->outbox_head].frame;
+	r_data = frame.ptr() + peer->outbox_offset;
+	r_size = frame.size() - peer->outbox_offset;
+	return true;
+}
+
+void CNodePeerScheduler::consume_outbound(int fd, int64_t bytes) {
+	Peer *peer = peers.getptr(fd);
+	if (peer == nullptr || peer->outbox_head >= peer->outbox.size()) {
+		return;
+	}
+	peer->outbox_offset += bytes;
+	peer->outbox_bytes -= bytes;
+	if (peer->outbox_offset < peer->outbox[peer->outbox_head].frame.size()) {
+		return;
+	}
+	peer->outbox[peer->outbox_head].frame = PackedByteArray();
+	peer->outbox_head++;
+	peer->outbox_offset = 0;
+	if (peer->outbox_head == peer->outbox.size()) {
+		peer->outbox.clear();
+		peer->outbox_head = 0;
+	}
+}
+
+bool CNodePeerScheduler::is_writing(int fd) const {
+	const Peer *peer = peers.getptr(fd);
+	return peer != nullptr && peer->outbox_offset > 0;
+}
+
+CNodeServer *CNodeServer::singleton = nullptr;
+
+void CNodeServer::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("_add_to_scene_tree"), &CNodeServer::_add_to_scene_tree);
+	ClassDB::bind_method(D_METHOD("_on_tree_node_added", "node"), &CNodeServer::_on_tree_node_added);
+	ClassDB::bind_method(D_METHOD("_on_tree_node_removed", "node"), &CNodeServer::_on_tree_node_removed);
+	ClassDB::bind_method(D_METHOD("_on_tree_node_renamed", "node"), &CNodeServer::_on_tree_node_renamed);
+	ClassDB::bind_method(D_METHOD("_on_cached_node_removed", "node"), &CNodeServer::_on_cached_node_removed);
+	ClassDB::bind_method(D_METHOD("_on_cached_node_renamed", "node"), &CNodeServer::_on_cached_node_renamed);
+	ClassDB::bind_vararg_method(METHOD_FLAGS_DEFAULT, "_on_awaited_signal", &CNodeServer::_on_awaited_signal, MethodInfo("_on_awaited_signal"));
+}
+
+CNodeServer::CNodeServer() : initialized(false), cookie_copy(nullptr), next_job_id(1) {
+	singleton = this;
+}
+
+CNodeServer::~CNodeServer() {
+	if (singleton == this) {
+		singleton = nullptr;
+	}
+
+	for (uint32_t i = 0; i < tree_watchers.size(); i++) {
+		ei_x_free(&tree_watchers[i].pending);
+	}
+	tree_watchers.clear();
+
+	clear_scene_cache();
+	loaded_resources.clear();
+
+	for (uint32_t i = 0; i < rid_handles.size(); i++) {
+		_free_rid_slot(i);
+	}
+
+	// Cleanup: close listen_fd if still open
+	if (listen_fd >= 0) {
+		close(listen_fd);
+		listen_fd = -1;
+	}
+
+	// Clean up cookie string
+	if (cookie_copy != nullptr) {
+		delete[] cookie_copy;
+		cookie_copy = nullptr;
+	}
+}
+
+void CNodeServer::_add_to_scene_tree() {
+	// Add this node to the scene tree
+	Engine *engine = Engine::get_singleton();
+	if (engine == nullptr) {
+		UtilityFunctions::printerr("Godot CNode: Engine not available in _add_to_scene_tree");
+		return;
+	}
+
+	MainLoop *main_loop = engine->get_main_loop();
+	if (main_loop == nullptr) {
+		UtilityFunctions::printerr("Godot CNode: Main loop not available in _add_to_scene_tree");
+		return;
+	}
+
+	SceneTree *scene_tree = Object::cast_to<SceneTree>(main_loop);
+	if (scene_tree == nullptr) {
+		UtilityFunctions::printerr("Godot CNode: SceneTree not available in _add_to_scene_tree");
+		return;
+	}
+
+	// Add to root window
+	Window *root = scene_tree->get_root();
+	if (root != nullptr && get_parent() == nullptr) {
+		root->add_child(this);
+		UtilityFunctions::print("Godot CNode: CNodeServer node added to root window");
+	} else if (get_parent() == nullptr) {
+		// Try current scene as fallback
+		Node *current_scene = scene_tree->get_current_scene();
+		if (current_scene != nullptr) {
+			current_scene->add_child(this);
+			UtilityFunctions::print("Godot CNode: CNodeServer node added to current scene");
 		} else {
-			printf("Godot CNode: Connected from node: (nodename not provided)\n");
+			UtilityFunctions::printerr("Godot CNode: Could not add CNodeServer node to scene tree");
+		}
+	}
+}
+
+void CNodeServer::_ready() {
+	// Initialize CNode on main thread
+	UtilityFunctions::print("Godot CNode: CNodeServer node ready, initializing CNode...");
+
+	// Get cookie from environment or use default
+	String cookie;
+	OS *os = OS::get_singleton();
+	if (os) {
+		String env_cookie = os->get_environment("GODOT_CNODE_COOKIE");
+		if (!env_cookie.is_empty()) {
+			cookie = env_cookie.strip_edges();
+			UtilityFunctions::print("Godot CNode: Using cookie from GODOT_CNODE_COOKIE environment variable");
+		}
+	}
+
+	if (cookie.is_empty()) {
+		// Use default cookie
+		cookie = "godotcookie";
+		UtilityFunctions::print("Godot CNode: Using default cookie");
+	}
+
+	// Store cookie as C string
+	size_t cookie_len = cookie.length();
+	cookie_copy = new char[cookie_len + 1];
+	memcpy(cookie_copy, cookie.utf8().get_data(), cookie_len);
+	cookie_copy[cookie_len] = '\0';
+
+	// Initialize instances array
+	memset(instances, 0, sizeof(instances));
+
+	// Try different hostname options
+	char hostname[256] = { 0 };
+	char nodename[512] = { 0 };
+	const char *nodename_options[4];
+	int option_count = 0;
+
+	nodename_options[option_count++] = "godot@127.0.0.1";
+	nodename_options[option_count++] = "godot@localhost";
+
+#ifndef _WIN32
+	if (gethostname(hostname, sizeof(hostname) - 1) == 0) {
+		if (strlen(hostname) > 6 && strcmp(hostname + strlen(hostname) - 6, ".local") != 0) {
+			snprintf(nodename, sizeof(nodename), "godot@%s", hostname);
+			nodename_options[option_count++] = nodename;
+		}
+	}
+#endif
+	nodename_options[option_count] = nullptr;
+
+	bool init_success = false;
+	for (int i = 0; nodename_options[i] != nullptr; i++) {
+		if (init_cnode(const_cast<char *>(nodename_options[i]), cookie_copy) == 0) {
+			init_success = true;
+			UtilityFunctions::print(String("Godot CNode: Successfully initialized with ") + nodename_options[i]);
+			break;
+		}
+	}
+
+	if (!init_success) {
+		UtilityFunctions::printerr("Godot CNode: Failed to initialize CNode with all hostname options");
+		return;
+	}
+
+	_load_process_settings();
+	// Cheap when a snapshot for this engine exists; otherwise it is built on the first introspection call
+	class_metadata.map_snapshot(CLASS_SNAPSHOT_PATH, CNodeClassMetadata::compute_hash());
+	initialized = true;
+	UtilityFunctions::print(String("Godot CNode: CNodeServer initialized and ready (listen_fd: ") + itos(listen_fd) + ")");
+}
+
+/* Helper: Read a network/cnode/ project setting, registering it with its default first */
+static Variant get_cnode_setting(const String &name, const Variant &default_value, PropertyHint hint = PROPERTY_HINT_NONE, const String &hint_string = "") {
+	ProjectSettings *settings = ProjectSettings::get_singleton();
+	String path = "network/cnode/" + name;
+	if (!settings->has_setting(path)) {
+		settings->set_setting(path, default_value);
+	}
+	settings->set_initial_value(path, default_value);
+
+	Dictionary info;
+	info["name"] = path;
+	info["type"] = default_value.get_type();
+	info["hint"] = hint;
+	info["hint_string"] = hint_string;
+	settings->add_property_info(info);
+	return settings->get_setting(path);
+}
+
+void CNodeServer::_load_process_settings() {
+	int hook = get_cnode_setting("process_hook", PROCESS_HOOK_IDLE, PROPERTY_HINT_ENUM, "Idle,Physics,Both").operator int64_t();
+	process_hook = hook >= PROCESS_HOOK_IDLE && hook <= PROCESS_HOOK_BOTH ? (ProcessHook)hook : PROCESS_HOOK_IDLE;
+	idle_budget.max_messages = MAX(1, (int)get_cnode_setting("idle_max_messages", 64, PROPERTY_HINT_RANGE, "1,4096,1,or_greater").operator int64_t());
+	idle_budget.max_usec = MAX(0, get_cnode_setting("idle_max_usec", 2000, PROPERTY_HINT_RANGE, "0,100000,1,suffix:us").operator int64_t());
+	physics_budget.max_messages = MAX(1, (int)get_cnode_setting("physics_max_messages", 64, PROPERTY_HINT_RANGE, "1,4096,1,or_greater").operator int64_t());
+	physics_budget.max_usec = MAX(0, get_cnode_setting("physics_max_usec", 2000, PROPERTY_HINT_RANGE, "0,100000,1,suffix:us").operator int64_t());
+	peer_weights = get_cnode_setting("peer_weights", Dictionary()).operator Dictionary();
+	split_lanes = get_cnode_setting("split_lanes", true).operator bool();
+	scheduler.set_limits(
+			MAX(1, (int)get_cnode_setting("inbound_max_messages", 1024, PROPERTY_HINT_RANGE, "1,65536,1,or_greater").operator int64_t()),
+			MAX((int64_t)1, get_cnode_setting("inbound_max_bytes", 16 << 20, PROPERTY_HINT_RANGE, "1,1073741824,1,or_greater,suffix:B").operator int64_t()),
+			MAX((int64_t)1, get_cnode_setting("outbound_max_bytes", 16 << 20, PROPERTY_HINT_RANGE, "1,1073741824,1,or_greater,suffix:B").operator int64_t()));
+}
+
+int CNodeServer::get_peer_weight(const String &node_name) const {
+	// "name@host" first, then plain "name" so one entry covers a node on any host
+	Variant weight = peer_weights.get(node_name, Variant());
+	if (weight.get_type() == Variant::NIL) {
+		weight = peer_weights.get(node_name.get_slice("@", 0), 1);
+	}
+	return MAX(1, (int)weight.operator int64_t());
+}
+
+void CNodeServer::_service_network(const ServiceBudget &budget) {
+	// A zero time budget leaves only the message limit
+	Time *time = Time::get_singleton();
+	uint64_t deadline = budget.max_usec > 0 ? time->get_ticks_usec() + budget.max_usec : UINT64_MAX;
+	for (int i = 0; i < budget.max_messages; i++) {
+		// result: 0 = processed something, 1 = nothing to process, -1 = error/shutdown
+		int result = process_cnode_frame();
+		if (result < 0) {
+			UtilityFunctions::printerr("Godot CNode: process_cnode_frame() returned error, shutting down");
+			initialized = false;
+			return;
+		}
+		if (result > 0 || time->get_ticks_usec() >= deadline) {
+			break;
+		}
+	}
+}
+
+void CNodeServer::_process(double) {
+	if (!initialized || listen_fd < 0) {
+		return;
+	}
+
+	// Process CNode operations (non-blocking) within this hook's budget
+	if (process_hook != PROCESS_HOOK_PHYSICS) {
+		_service_network(idle_budget);
+	}
+
+	_run_due_requests(idle_wheel, Engine::get_singleton()->get_process_frames());
+	_process_spawn_jobs();
+	_process_nav_path_jobs();
+	_poll_resource_loads();
+	_flush_multimesh_updates();
+	_flush_tree_watchers();
+	_complete_frame_waits();
+	_expire_pending_replies();
+}
+
+void CNodeServer::_physics_process(double) {
+	if (lockstep && initialized) {
+		_lockstep_tick();
+	}
+	if (process_hook != PROCESS_HOOK_IDLE && initialized && listen_fd >= 0) {
+		_service_network(physics_budget);
+	}
+	_run_due_requests(physics_wheel, Engine::get_singleton()->get_physics_frames());
+}
+
+void CNodeServer::set_lockstep(int fd, bool enabled) {
+	// The held tick must come before every other node's physics callbacks, so ops land before any of them run
+	if (enabled && !lockstep) {
+		saved_physics_priority = get_physics_process_priority();
+		set_physics_process_priority(INT32_MIN);
+	} else if (!enabled && lockstep) {
+		set_physics_process_priority(saved_physics_priority);
+	}
+	lockstep = enabled;
+	lockstep_fd = enabled ? fd : -1;
+	if (!enabled && step_pending) {
+		// Let the engine free-run again; the outstanding step still gets its reply now
+		_finish_step();
+	}
+}
+
+bool CNodeServer::begin_step(int fd, uint64_t reply_id, uint64_t ticks, const LocalVector<ObjectID> &ids, const LocalVector<StringName> &fields) {
+	if (step_pending) {
+		return false;
+	}
+	current_step.fd = fd;
+	current_step.reply_id = reply_id;
+	current_step.ticks_left = ticks;
+	current_step.ids = ids;
+	current_step.fields = fields;
+	step_pending = true;
+	return true;
+}
+
+void CNodeServer::_lockstep_tick() {
+	// Runs before any other node's physics callbacks (lowest physics priority while in lockstep), so the
+	// previous tick's results are synced by now. _process work (spawn jobs, loads, tree diffs, frame
+	// waits) does not advance while the tick is held
+	if (step_pending && current_step.ticks_left == 0) {
+		_finish_step();
+	}
+
+	// Hold the tick until the client grants more
+	while (lockstep && !step_pending && initialized) {
+		int result = process_cnode_frame();
+		if (result < 0) {
+			UtilityFunctions::printerr("Godot CNode: process_cnode_frame() returned error, shutting down");
+			initialized = false;
+		} else if (result > 0) {
+			OS::get_singleton()->delay_usec(LOCKSTEP_POLL_USEC);
 		}
-		fflush(stdout);
+	}
 
-		// Register global name "godot_server" so Erlang processes can send messages to it
-		// This must be done after accepting a connection (global names require a connection to an Erlang node)
-		// According to: https://www.erlang.org/doc/apps/erl_interface/ei_users_guide.html#using-global-names
-		static bool name_registered_main = false;
-		if (!name_registered_main) {
-			erlang_pid *self_pid = ei_self(&ec);
-			if (self_pid != nullptr && ei_global_register(fd, "godot_server", self_pid) == 0) {
-				printf("Godot CNode: ✓ Registered global name 'godot_server'\n");
-				fflush(stdout);
-				name_registered_main = true;
-			} else {
-				fprintf(stderr, "Godot CNode: Warning: Failed to register global name 'godot_server' (errno: %d, %s)\n", errno, strerror(errno));
-				fflush(stderr);
-			}
+	if (step_pending) {
+		current_step.ticks_left--;
+	}
+}
+
+void CNodeServer::_finish_step() {
+	step_pending = false;
+	if (!pending_replies.has(current_step.reply_id)) {
+		return; // The client went away
+	}
+
+	CNodeRequestScope scope(current_step.fd);
+	ei_x_buff reply;
+	ei_x_new(&reply);
+	ei_x_encode_tuple_header(&reply, 3);
+	ei_x_encode_atom(&reply, "ok");
+	ei_x_encode_ulonglong(&reply, Engine::get_singleton()->get_physics_frames());
+	encode_step_state(current_step.ids, current_step.fields, &reply);
+	complete_reply(current_step.reply_id, &reply);
+	ei_x_free(&reply);
+}
+
+uint64_t CNodeServer::defer_reply(int fd, const erlang_pid &pid, const erlang_ref &tag, int64_t timeout_ms) {
+	PendingReply pending;
+	pending.target.fd = fd;
+	pending.target.pid = pid;
+	pending.target.tag = tag;
+	pending.deadline_usec = timeout_ms > 0 ? Time::get_singleton()->get_ticks_usec() + (uint64_t)timeout_ms * 1000 : 0;
+	uint64_t reply_id = next_reply_id++;
+	pending_replies.insert(reply_id, pending);
+	return reply_id;
+}
+
+bool CNodeServer::complete_reply(uint64_t reply_id, ei_x_buff *reply) {
+	HashMap<uint64_t, PendingReply>::Iterator pending = pending_replies.find(reply_id);
+	if (pending == pending_replies.end()) {
+		return false;
+	}
+	CNodeReplyTarget target = pending->value.target;
+	pending_replies.remove(pending);
+	send_reply(reply, target.fd, &target.pid, &target.tag);
+	return true;
+}
+
+void CNodeServer::_expire_pending_replies() {
+	if (pending_replies.is_empty()) {
+		return;
+	}
+	uint64_t now = Time::get_singleton()->get_ticks_usec();
+	LocalVector<uint64_t> expired;
+	for (const KeyValue<uint64_t, PendingReply> &E : pending_replies) {
+		if (E.value.deadline_usec != 0 && E.value.deadline_usec <= now) {
+			expired.push_back(E.key);
 		}
+	}
+	for (uint32_t i = 0; i < expired.size(); i++) {
+		ei_x_buff reply;
+		ei_x_new(&reply);
+		ei_x_encode_tuple_header(&reply, 2);
+		ei_x_encode_atom(&reply, "error");
+		ei_x_encode_string(&reply, "timeout");
+		complete_reply(expired[i], &reply);
+		ei_x_free(&reply);
+	}
+	_prune_signal_waits();
+}
 
-		/* Receive message - use select() to wait for data before calling ei_receive_msg */
-		struct timeval wait_start;
-		gettimeofday(&wait_start, NULL);
-		printf("Godot CNode: Waiting to receive message from fd: %d at %ld.%06d...\n", fd, wait_start.tv_sec, wait_start.tv_usec);
-		fflush(stdout);
+void CNodeServer::wait_frames(uint64_t reply_id, uint64_t frame) {
+	FrameWait wait;
+	wait.reply_id = reply_id;
+	wait.frame = frame;
+	frame_waits.push_back(wait);
+}
 
-		/* Wait for data to be available using select() */
-		fd_set recv_fds;
-		struct timeval recv_timeout;
-		FD_ZERO(&recv_fds);
-		FD_SET(fd, &recv_fds);
-		recv_timeout.tv_sec = 5; /* 5 second timeout */
-		recv_timeout.tv_usec = 0;
-		int select_res = select(fd + 1, &recv_fds, NULL, NULL, &recv_timeout);
-		bool data_available = (select_res > 0 && FD_ISSET(fd, &recv_fds));
-		if (data_available) {
-			/* Data is available, try to receive */
-			printf("Godot CNode: select() indicates data available, calling ei_receive_msg...\n");
-			fflush(stdout);
-			res = ei_receive_msg(fd, &msg, &x);
-			printf("Godot CNode: ei_receive_msg returned: %d", res);
-			fflush(stdout);
-		} else if (select_res == 0) {
-			/* Timeout - no data available */
-			printf("Godot CNode: select() timeout, no data available\n");
-			fflush(stdout);
-			ei_x_free(&x);
-			close(fd);
-			continue;
-		} else {
-			/* select() error */
-			printf("Godot CNode: select() error (errno: %d, %s)\n", errno, strerror(errno));
-			fflush(stdout);
-			ei_x_free(&x);
-			close(fd);
-			continue;
+Error CNodeServer::await_signal(uint64_t reply_id, Object *obj, const StringName &signal) {
+	if (!obj->has_signal(signal)) {
+		return ERR_DOES_NOT_EXIST;
+	}
+	// The reply id rides along after the signal's own arguments
+	SignalWait wait;
+	wait.object = ObjectID(obj->get_instance_id());
+	wait.signal = signal;
+	wait.callback = Callable(this, "_on_awaited_signal").bind(reply_id);
+	// Deferred, so a signal emitted on a worker or physics thread is answered on the main thread
+	Error err = obj->connect(signal, wait.callback, CONNECT_DEFERRED | CONNECT_ONE_SHOT);
+	if (err == OK) {
+		signal_waits.insert(reply_id, wait);
+	}
+	return err;
+}
+
+void CNodeServer::_on_awaited_signal(const Variant **p_args, GDExtensionInt p_argcount, GDExtensionCallError &r_error) {
+	r_error.error = GDEXTENSION_CALL_OK;
+	if (p_argcount < 1) {
+		return;
+	}
+	uint64_t reply_id = p_args[p_argcount - 1]->operator uint64_t();
+	signal_waits.erase(reply_id);
+	if (!pending_replies.has(reply_id)) {
+		return;
+	}
+
+	CNodeRequestScope scope(pending_replies[reply_id].target.fd);
+	ei_x_buff reply;
+	ei_x_new(&reply);
+	ei_x_encode_tuple_header(&reply, 2);
+	ei_x_encode_atom(&reply, "ok");
+	if (p_argcount > 1) {
+		ei_x_encode_list_header(&reply, p_argcount - 1);
+		for (GDExtensionInt i = 0; i < p_argcount - 1; i++) {
+			variant_to_bert(*p_args[i], &reply);
 		}
+	}
+	ei_x_encode_empty_list(&reply);
+	complete_reply(reply_id, &reply);
+	ei_x_free(&reply);
+}
 
-		if (res == ERL_TICK) {
-			/* Just a tick, continue */
-			printf(" (ERL_TICK - keepalive)\n");
+void CNodeServer::_prune_signal_waits() {
+	// Waits whose reply timed out or lost its connection must not keep the signal connected
+	LocalVector<uint64_t> stale;
+	for (const KeyValue<uint64_t, SignalWait> &E : signal_waits) {
+		if (!pending_replies.has(E.key)) {
+			stale.push_back(E.key);
+		}
+	}
+	for (uint32_t i = 0; i < stale.size(); i++) {
+		const SignalWait &wait = signal_waits[stale[i]];
+		Object *obj = ObjectDB::get_instance(wait.object);
+		if (obj != nullptr && obj->is_connected(wait.signal, wait.callback)) {
+			obj->disconnect(wait.signal, wait.callback);
+		}
+		signal_waits.erase(stale[i]);
+	}
+}
+
+void CNodeServer::_complete_frame_waits() {
+	uint64_t frame = Engine::get_singleton()->get_process_frames();
+	for (uint32_t i = 0; i < frame_waits.size();) {
+		if (frame_waits[i].frame > frame) {
+			i++;
 			continue;
-		} else if (res == ERL_ERROR) {
-			int saved_errno = errno;
-			fprintf(stderr, " (ERL_ERROR - errno: %d, %s)\n", saved_errno, strerror(saved_errno));
-			/* macOS issue: errno 42 (Protocol not available) or errno 60 (Operation timed out) */
-			/* When ei_receive_msg fails, try raw read - the error might just mean ei_receive_msg couldn't decode it */
-			/* Note: errno 60 can occur even when data is available - ei_receive_msg just couldn't decode it */
-			if (saved_errno == 42 || saved_errno == ENOPROTOOPT || saved_errno == 60 || saved_errno == ETIMEDOUT) {
-				/* Try to process message from existing buffer if it has data */
-				printf("Godot CNode: Buffer index: %d, attempting to process message despite errno %d (data_available=%d)\n", x.index, saved_errno, data_available);
-				fflush(stdout);
-				if (x.index > 0) {
-					printf("Godot CNode: Attempting to process message from buffer (macOS compatibility, errno %d)\n", saved_errno);
-					fflush(stdout);
-					/* Process the message from buffer */
-					x.index = 0;
-					if (process_message(x.buff, &x.index, fd) < 0) {
-						fprintf(stderr, "Error processing message\n");
-					}
-					ei_x_free(&x);
-					close(fd);
-					continue;
-				} else {
-					/* Buffer is empty but ei_receive_msg failed - try raw read anyway */
-					/* Even if select() didn't indicate data, the error might mean there's data ei_receive_msg couldn't decode */
-					printf("Godot CNode: Buffer is empty but ei_receive_msg failed, trying raw read (errno %d)...\n", saved_errno);
-					fflush(stdout);
-					unsigned char raw_buf[4096];
-					ssize_t bytes_read = read(fd, raw_buf, sizeof(raw_buf));
-					if (bytes_read > 0) {
-						printf("Godot CNode: Raw read got %zd bytes, attempting to decode...\n", bytes_read);
-						fflush(stdout);
+		}
+		ei_x_buff reply;
+		ei_x_new(&reply);
+		ei_x_encode_tuple_header(&reply, 2);
+		ei_x_encode_atom(&reply, "ok");
+		ei_x_encode_ulonglong(&reply, frame);
+		complete_reply(frame_waits[i].reply_id, &reply);
+		ei_x_free(&reply);
+		frame_waits.remove_at_unordered(i);
+	}
+}
 
-						/* Convert raw data to base64 for inspection */
-						const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-						char base64_buf[8192]; /* Enough for 4096 bytes * 4/3 + padding */
-						int base64_len = 0;
-						for (ssize_t i = 0; i < bytes_read; i += 3) {
-							unsigned char b1 = raw_buf[i];
-							unsigned char b2 = (i + 1 < bytes_read) ? raw_buf[i + 1] : 0;
-							unsigned char b3 = (i + 2 < bytes_read) ? raw_buf[i + 2] : 0;
+void CNodeServer::schedule_physics_request(uint64_t physics_frame, const char *term, int term_len) {
+	physics_wheel.schedule(physics_frame, term, term_len, current_request_fd);
+}
 
-							base64_buf[base64_len++] = base64_chars[(b1 >> 2) & 0x3F];
-							base64_buf[base64_len++] = base64_chars[((b1 << 4) | (b2 >> 4)) & 0x3F];
-							if (i + 1 < bytes_read) {
-								base64_buf[base64_len++] = base64_chars[((b2 << 2) | (b3 >> 6)) & 0x3F];
-							} else {
-								base64_buf[base64_len++] = '=';
-							}
-							if (i + 2 < bytes_read) {
-								base64_buf[base64_len++] = base64_chars[b3 & 0x3F];
-							} else {
-								base64_buf[base64_len++] = '=';
-							}
-						}
-						base64_buf[base64_len] = '\0';
-						printf("Godot CNode: Raw data (base64, FULL BUFFER): %s\n", base64_buf);
-						fflush(stdout);
+void CNodeServer::schedule_idle_request(uint64_t process_frame, const char *term, int term_len) {
+	idle_wheel.schedule(process_frame, term, term_len, current_request_fd);
+}
 
-						/* Also print hex dump of first 64 bytes for inspection */
-						printf("Godot CNode: Raw data (hex, first 64 bytes): ");
-						for (ssize_t i = 0; i < bytes_read && i < 64; i++) {
-							printf("%02x ", raw_buf[i]);
-						}
-						printf("\n");
-						fflush(stdout);
+void CNodeServer::schedule_physics_call(uint64_t physics_frame, const char *term, int term_len, int fd, const erlang_pid &pid, const erlang_ref &tag) {
+	CNodeReplyTarget reply_to;
+	reply_to.fd = fd;
+	reply_to.pid = pid;
+	reply_to.tag = tag;
+	physics_wheel.schedule(physics_frame, term, term_len, fd, &reply_to);
+}
 
-						/* Print full hex dump for debugging */
-						printf("Godot CNode: Raw data (hex, FULL BUFFER, %zd bytes):\n", bytes_read);
-						for (ssize_t i = 0; i < bytes_read; i++) {
-							if (i % 16 == 0) {
-								printf("%04zx: ", i);
-							}
-							printf("%02x ", raw_buf[i]);
-							if (i % 16 == 15 || i == bytes_read - 1) {
-								printf("\n");
-							}
-						}
-						fflush(stdout);
+void CNodeServer::_run_due_requests(CNodeTimerWheel &wheel, uint64_t frame) {
+	LocalVector<CNodeTimerWheel::Entry> due;
+	wheel.collect_due(frame, due);
+	for (uint32_t i = 0; i < due.size(); i++) {
+		int index = 0;
+		CNodeTimerWheel::Entry &entry = due[i];
+		CNodeRequestScope scope(entry.fd);
+		current_request_received_usec = entry.received_usec;
+		int result = entry.has_reply
+				? handle_call(entry.request.ptr(), &index, entry.reply_to.fd, &entry.reply_to.pid, &entry.reply_to.tag)
+				: handle_cast(entry.request.ptr(), &index);
+		if (result < 0) {
+			fprintf(stderr, "Godot CNode: Scheduled request failed on frame %llu\n", (unsigned long long)frame);
+		}
+	}
+}
 
-						/* The raw data is in Erlang distribution protocol format */
-						/* Distribution protocol: [Length (4 bytes BE)] [Message Type] [Payload] */
-						/* We need to skip the length and message type to get to the BERT payload */
-						if (bytes_read >= 5) {
-							/* Distribution protocol SEND format: [4-byte BE length] [1-byte 'p'] [To Name] [Message] */
-							/* The "To Name" is encoded, then the actual BERT message follows */
-							/* We need to skip the "To Name" to get to the actual message */
-							int offset = 5; /* Skip header */
+uint64_t CNodeServer::start_spawn_job(int fd, const erlang_pid &pid, const erlang_ref &tag, Node *target, const LocalVector<CNodeSpawnEntry> &entries, int batch) {
+	SpawnJob job;
+	job.id = next_job_id++;
+	job.fd = fd;
+	job.pid = pid;
+	job.tag = tag;
+	job.target = target->get_instance_id();
+	job.entries = entries;
+	job.batch = batch;
+	spawn_jobs.push_back(job);
+	return job.id;
+}
 
-							/* Try to find ALL messages in the buffer */
-							/* The distribution protocol format is: [4-byte length] [1-byte 'p'] [To Name] [Message] */
-							/* The "To Name" is encoded as an atom (starts with 0x83), then the actual message follows */
-							/* Look for pattern: 0x83 followed by 0x68 (small tuple) or 0x6B (large tuple) */
-							/* Find all occurrences and process each message */
-							printf("Godot CNode: Searching for all messages in buffer (size: %zd bytes, offset: %d)\n", bytes_read, offset);
-							fflush(stdout);
+void CNodeServer::_process_spawn_jobs() {
+	for (uint32_t i = 0; i < spawn_jobs.size();) {
+		SpawnJob &job = spawn_jobs[i];
+		Node *target = Object::cast_to<Node>(ObjectDB::get_instance(job.target));
+		uint32_t from = job.ids.size();
+		uint32_t to = MIN(from + (uint32_t)job.batch, job.entries.size());
+
+		// Nodes attach as they are created so each frame only pays for its own batch
+		// A freed target makes the remaining entries fail (ID 0) rather than leak
+		spawn_entries(job.entries, from, to, target, true, job.ids);
+		if (to < job.entries.size()) {
+			i++;
+			continue;
+		}
 
-							/* Find all 0x83 bytes that are followed by tuple markers */
-							int msg_starts[10]; /* Max 10 messages */
-							int msg_count = 0;
-							for (int i = offset; i < bytes_read - 2 && msg_count < 10; i++) {
-								if (raw_buf[i] == 0x83) {
-									/* Check if this is followed by a tuple marker (0x68 = small tuple, 0x6B = large tuple) */
-									if ((raw_buf[i + 1] == 0x68 || raw_buf[i + 1] == 0x6B)) {
-										msg_starts[msg_count] = i;
-										printf("Godot CNode: Found potential message at offset %d (hex: 0x%02x 0x%02x), message #%d\n",
-												i, raw_buf[i], raw_buf[i + 1], msg_count + 1);
-										fflush(stdout);
-										msg_count++;
-									}
-								}
-							}
+		// {spawned, JobId, Ids}
+		CNodeRequestScope scope(job.fd);
+		ei_x_buff message;
+		ei_x_new_with_version(&message);
+		ei_x_encode_tuple_header(&message, 3);
+		ei_x_encode_atom(&message, "spawned");
+		ei_x_encode_ulonglong(&message, job.id);
+		encode_spawned_ids(job.ids, &message);
+		send_message(job.fd, &job.pid, &message);
+		ei_x_free(&message);
+		spawn_jobs.remove_at(i);
+	}
+}
 
-							printf("Godot CNode: Found %d potential message(s) in buffer\n", msg_count);
-							fflush(stdout);
+/* Helper: Scene cache and pool key - uid:// paths resolve to the res:// path instances report */
+static String normalize_scene_path(const String &path) {
+	if (!path.begins_with("uid://")) {
+		return path;
+	}
+	ResourceUID *uids = ResourceUID::get_singleton();
+	int64_t id = uids->text_to_id(path);
+	return id != ResourceUID::INVALID_ID && uids->has_id(id) ? uids->get_id_path(id) : path;
+}
 
-							/* Process each message found */
-							/* The first one (offset 5) is the "To Name" atom, skip it */
-							/* The rest are actual messages */
-							for (int msg_idx = 1; msg_idx < msg_count; msg_idx++) {
-								int msg_start = msg_starts[msg_idx];
-								printf("Godot CNode: Processing message #%d at offset %d\n", msg_idx, msg_start);
-								fflush(stdout);
+bool CNodeServer::is_releasable_scene_instance(Node *node) const {
+	if (node == nullptr || node == this || node->get_scene_file_path().is_empty()) {
+		return false;
+	}
+	SceneTree *tree = get_tree();
+	return tree == nullptr || tree->get_current_scene() != node;
+}
 
-								/* Calculate payload length - from this message to end of buffer or next message */
-								int payload_len;
-								if (msg_idx + 1 < msg_count) {
-									/* Next message starts at msg_starts[msg_idx + 1] */
-									payload_len = msg_starts[msg_idx + 1] - msg_start;
-								} else {
-									/* Last message - goes to end of buffer */
-									payload_len = (int)bytes_read - msg_start;
-								}
-								printf("Godot CNode: Found message at offset %d, extracted %d bytes, attempting to decode...\n", msg_start, payload_len);
-								fflush(stdout);
+Ref<PackedScene> CNodeServer::get_cached_scene(const String &p_path) {
+	String path = normalize_scene_path(p_path);
+	Ref<PackedScene> *cached = scene_cache.getptr(path);
+	if (cached != nullptr) {
+		return *cached;
+	}
+	if (path.is_empty()) {
+		return Ref<PackedScene>();
+	}
+	Ref<PackedScene> scene = ResourceLoader::get_singleton()->load(path, "PackedScene");
+	if (scene.is_valid()) {
+		scene_cache.insert(path, scene);
+	}
+	return scene;
+}
 
-								/* Print hex of message start for debugging */
-								printf("Godot CNode: Message start (hex, first 32 bytes): ");
-								for (int i = 0; i < 32 && (msg_start + i) < bytes_read; i++) {
-									printf("%02x ", raw_buf[msg_start + i]);
-								}
-								printf("\n");
-								fflush(stdout);
+Node *CNodeServer::acquire_scene_instance(const String &p_path) {
+	String path = normalize_scene_path(p_path);
+	LocalVector<ObjectID> *pool = scene_pools.getptr(path);
+	while (pool != nullptr && !pool->is_empty()) {
+		ObjectID id = (*pool)[pool->size() - 1];
+		pool->resize(pool->size() - 1);
+		Node *node = Object::cast_to<Node>(ObjectDB::get_instance(id));
+		// Skip instances freed or re-parented since they were released
+		if (node != nullptr && node->get_parent() == nullptr) {
+			return node;
+		}
+	}
 
-								/* The payload already has BERT version, so use it directly */
-								ei_x_buff raw_x;
-								ei_x_new(&raw_x); /* Don't add version, payload has it */
-								ei_x_append_buf(&raw_x, (const char *)&raw_buf[msg_start], payload_len);
-								raw_x.index = 0;
+	Ref<PackedScene> scene = get_cached_scene(path);
+	if (scene.is_null()) {
+		return nullptr;
+	}
+	return scene->instantiate();
+}
 
-								/* The message from distribution protocol is already a tuple, so we need to decode it */
-								/* Format: {'$gen_call', {From, Tag}, Request} or {rex, From, {'$gen_call', ...}} */
-								/* Skip version (already at index 0, which is the 0x83 byte) */
-								int msg_version;
-								printf("Godot CNode: Attempting to decode version, index before: %d, first byte: 0x%02x\n", raw_x.index, (unsigned char)raw_x.buff[raw_x.index]);
-								fflush(stdout);
-								if (ei_decode_version(raw_x.buff, &raw_x.index, &msg_version) < 0) {
-									fprintf(stderr, "Error: Could not decode BERT version from raw message (index: %d, first byte: 0x%02x)\n", raw_x.index, (unsigned char)raw_x.buff[0]);
-									fflush(stderr);
-									ei_x_free(&raw_x);
-									continue;
-								}
-								printf("Godot CNode: Decoded version: %d, index after: %d, next byte: 0x%02x\n", msg_version, raw_x.index, (unsigned char)raw_x.buff[raw_x.index]);
-								fflush(stdout);
+void CNodeServer::track_detached_instance(int fd, Node *node) {
+	detached_instances[node->get_instance_id()] = fd;
+}
 
-								/* Decode tuple header */
-								int tuple_arity;
-								printf("Godot CNode: Attempting to decode tuple header, index: %d, bytes: 0x%02x 0x%02x\n", raw_x.index, (unsigned char)raw_x.buff[raw_x.index], (unsigned char)raw_x.buff[raw_x.index + 1]);
-								fflush(stdout);
-								if (ei_decode_tuple_header(raw_x.buff, &raw_x.index, &tuple_arity) < 0) {
-									fprintf(stderr, "Error: Could not decode tuple header from raw message (index: %d)\n", raw_x.index);
-									fflush(stderr);
-									ei_x_free(&raw_x);
-									continue;
-								}
-								printf("Godot CNode: Decoded tuple arity: %d, index after: %d\n", tuple_arity, raw_x.index);
-								fflush(stdout);
+bool CNodeServer::release_scene_instance(Node *node) {
+	if (!is_releasable_scene_instance(node)) {
+		return false;
+	}
+	String path = normalize_scene_path(node->get_scene_file_path());
+	LocalVector<ObjectID> *pool = scene_pools.getptr(path);
+	if (pool == nullptr) {
+		pool = &scene_pools.insert(path, LocalVector<ObjectID>())->value;
+	}
+	if (pool->size() >= SCENE_POOL_LIMIT) {
+		node->queue_free();
+		return false;
+	}
 
-								/* Decode first atom to determine message type */
-								/* Check type first (this doesn't advance index) */
-								int atom_type, atom_size;
-								int atom_index = raw_x.index; /* Save position */
-								if (ei_get_type(raw_x.buff, &atom_index, &atom_type, &atom_size) < 0) {
-									fprintf(stderr, "Error: Could not get type at index %d\n", raw_x.index);
-									fflush(stderr);
-									ei_x_free(&raw_x);
-									continue;
-								}
-								printf("Godot CNode: Type at index %d: 0x%02x (size: %d), index after get_type: %d\n", raw_x.index, atom_type, atom_size, atom_index);
-								fflush(stdout);
+	Node *parent = node->get_parent();
+	if (parent != nullptr) {
+		parent->remove_child(node);
+	}
+	detached_instances.erase(node->get_instance_id());
+	pool->push_back(ObjectID(node->get_instance_id()));
+	return true;
+}
 
-								char first_atom[MAXATOMLEN];
-								printf("Godot CNode: Attempting to decode atom, index: %d, bytes: 0x%02x 0x%02x 0x%02x\n", raw_x.index, (unsigned char)raw_x.buff[raw_x.index], (unsigned char)raw_x.buff[raw_x.index + 1], (unsigned char)raw_x.buff[raw_x.index + 2]);
-								fflush(stdout);
+void CNodeServer::clear_scene_cache() {
+	// Pooled instances are detached, nothing else will free them
+	for (KeyValue<String, LocalVector<ObjectID>> &E : scene_pools) {
+		for (uint32_t i = 0; i < E.value.size(); i++) {
+			Node *node = Object::cast_to<Node>(ObjectDB::get_instance(E.value[i]));
+			if (node != nullptr && node->get_parent() == nullptr) {
+				memdelete(node);
+			}
+		}
+	}
+	scene_pools.clear();
+	scene_cache.clear();
+}
 
-								/* Decode atom - 0x6b is ATOM_UTF8_EXT (2-byte length) */
-								/* ei_decode_atom might not support UTF-8, try manual parse */
-								int decode_res;
-								if (atom_type == 0x6b) {
-									/* ATOM_UTF8_EXT: [0x6b] [len_high] [len_low] [utf8_bytes...] */
-									unsigned char len_high = raw_x.buff[raw_x.index + 1];
-									unsigned char len_low = raw_x.buff[raw_x.index + 2];
-									int atom_len = (len_high << 8) | len_low;
-									if (atom_len > 0 && atom_len < MAXATOMLEN) {
-										memcpy(first_atom, &raw_x.buff[raw_x.index + 3], atom_len);
-										first_atom[atom_len] = '\0';
-										raw_x.index += 3 + atom_len; /* Skip type + 2-byte len + data */
-										decode_res = 0;
-										printf("Godot CNode: Manually decoded UTF-8 atom: '%s' (len: %d)\n", first_atom, atom_len);
-										fflush(stdout);
-									} else {
-										decode_res = -1;
-									}
-								} else {
-									/* Try standard ei_decode_atom */
-									decode_res = ei_decode_atom(raw_x.buff, &raw_x.index, first_atom);
-								}
+bool CNodeServer::load_async(int fd, const erlang_pid &pid, const erlang_ref &tag, const String &path, const String &type_hint) {
+	ResourceSubscriber subscriber;
+	subscriber.fd = fd;
+	subscriber.pid = pid;
+	subscriber.tag = tag;
+
+	// Already loaded - answer right away
+	Ref<Resource> *loaded = loaded_resources.getptr(path);
+	if (loaded != nullptr) {
+		_send_load_result(subscriber, path, *loaded);
+		return true;
+	}
 
-								if (decode_res < 0) {
-									fprintf(stderr, "Error: Could not decode first atom from raw message (index: %d, type: 0x%02x, bytes: 0x%02x 0x%02x 0x%02x)\n", raw_x.index, atom_type, (unsigned char)raw_x.buff[raw_x.index], (unsigned char)raw_x.buff[raw_x.index + 1], (unsigned char)raw_x.buff[raw_x.index + 2]);
-									fflush(stderr);
-									ei_x_free(&raw_x);
-									continue;
-								}
+	// Same path in flight - one threaded request, many subscribers
+	for (uint32_t i = 0; i < resource_loads.size(); i++) {
+		if (resource_loads[i].path == path) {
+			resource_loads[i].subscribers.push_back(subscriber);
+			return true;
+		}
+	}
 
-								printf("Godot CNode: Raw message - tuple arity: %d, first atom: %s\n", tuple_arity, first_atom);
-								fflush(stdout);
+	// Sub-threads let large resources use several of Godot's worker threads
+	if (ResourceLoader::get_singleton()->load_threaded_request(path, type_hint, true) != OK) {
+		return false;
+	}
+	ResourceLoad load;
+	load.path = path;
+	load.progress = -1.0;
+	load.subscribers.push_back(subscriber);
+	resource_loads.push_back(load);
+	return true;
+}
 
-								/* Now process based on message type */
-								if (strcmp(first_atom, "$gen_call") == 0) {
-									/* Direct gen_call: {'$gen_call', {From, Tag}, Request} */
-									printf("Godot CNode: Processing direct $gen_call from raw message\n");
-									fflush(stdout);
-									/* Decode {From, Tag} */
-									int from_arity;
-									if (ei_decode_tuple_header(raw_x.buff, &raw_x.index, &from_arity) < 0 || from_arity != 2) {
-										fprintf(stderr, "Error decoding From tuple in raw gen_call\n");
-										fflush(stderr);
-										ei_x_free(&raw_x);
-										continue;
-									}
-									erlang_pid from_pid;
-									erlang_ref tag_ref;
-									if (ei_decode_pid(raw_x.buff, &raw_x.index, &from_pid) < 0) {
-										fprintf(stderr, "Error decoding From PID in raw gen_call\n");
-										fflush(stderr);
-										ei_x_free(&raw_x);
-										continue;
-									}
-									if (ei_decode_ref(raw_x.buff, &raw_x.index, &tag_ref) < 0) {
-										fprintf(stderr, "Error decoding Tag in raw gen_call\n");
-										fflush(stderr);
-										ei_x_free(&raw_x);
-										continue;
-									}
-									/* Now handle the Request */
-									printf("Godot CNode: About to call handle_call for raw message (From PID: %s, Tag: %p)\n",
-											from_pid.node, (void *)&tag_ref);
-									fflush(stdout);
-									int call_result = handle_call(raw_x.buff, &raw_x.index, fd, &from_pid, &tag_ref);
-									if (call_result < 0) {
-										fprintf(stderr, "Error handling call from raw message\n");
-										fflush(stderr);
-									} else {
-										printf("Godot CNode: handle_call succeeded for raw message, reply should have been sent\n");
-										fflush(stdout);
-										/* GenServer call succeeded - give more time for reply to be sent and received */
-										usleep(200000); // 200ms - increased from 50ms
-									}
-								} else if (strcmp(first_atom, "rex") == 0) {
-									/* RPC wrapped: {rex, From, {'$gen_call', ...}} */
-									printf("Godot CNode: Processing rex message from raw message\n");
-									fflush(stdout);
-									/* Use process_message which handles rex format */
-									raw_x.index = 0; /* Reset to start */
-									int rex_result = process_message(raw_x.buff, &raw_x.index, fd);
-									if (rex_result < 0) {
-										fprintf(stderr, "Error processing rex message from raw read payload\n");
-										fflush(stderr);
-									} else {
-										/* GenServer call succeeded - give more time for reply to be sent and received */
-										usleep(200000); // 200ms - increased from 50ms
-									}
-								} else {
-									fprintf(stderr, "Error: Unknown message type in raw message: %s\n", first_atom);
-									fflush(stderr);
-								}
+void CNodeServer::unload_resource(const String &path) {
+	loaded_resources.erase(path);
+	scene_cache.erase(path);
+}
 
-								ei_x_free(&raw_x);
-								printf("Godot CNode: Finished processing message #%d\n", msg_idx);
-								fflush(stdout);
-							}
+void CNodeServer::_send_load_result(ResourceSubscriber &subscriber, const String &path, const Ref<Resource> &resource) {
+	CNodeRequestScope scope(subscriber.fd);
+	ei_x_buff message;
+	ei_x_new_with_version(&message);
+	if (resource.is_valid()) {
+		ei_x_encode_tuple_header(&message, 3);
+		ei_x_encode_atom(&message, "loaded");
+		ei_x_encode_string(&message, path.utf8().get_data());
+		ei_x_encode_longlong(&message, export_object_ref(resource.ptr()));
+	} else {
+		ei_x_encode_tuple_header(&message, 2);
+		ei_x_encode_atom(&message, "load_failed");
+		ei_x_encode_string(&message, path.utf8().get_data());
+	}
+	send_message(subscriber.fd, &subscriber.pid, &message);
+	ei_x_free(&message);
+}
 
-							if (msg_count == 0) {
-								printf("Godot CNode: Could not find any messages (BERT version 0x83) in payload\n");
-								fflush(stdout);
-							} else if (msg_count == 1) {
-								printf("Godot CNode: Found only 'To Name', no actual messages in buffer\n");
-								fflush(stdout);
-							} else {
-								printf("Godot CNode: Processed %d message(s) from buffer (skipped 'To Name')\n", msg_count - 1);
-								fflush(stdout);
-							}
-						} else {
-							printf("Godot CNode: Raw data too short (%zd bytes), expected at least 5\n", bytes_read);
-							fflush(stdout);
-						}
-					} else {
-						printf("Godot CNode: Raw read failed (bytes_read: %zd, errno: %d)\n", bytes_read, errno);
-						fflush(stdout);
-					}
+void CNodeServer::_poll_resource_loads() {
+	ResourceLoader *loader = ResourceLoader::get_singleton();
+	for (uint32_t i = 0; i < resource_loads.size();) {
+		ResourceLoad &load = resource_loads[i];
+		Array progress;
+		ResourceLoader::ThreadLoadStatus status = loader->load_threaded_get_status(load.path, progress);
+
+		if (status == ResourceLoader::THREAD_LOAD_IN_PROGRESS) {
+			double current = progress.size() > 0 ? progress[0].operator double() : 0.0;
+			if (current != load.progress) {
+				// {load_progress, Path, Progress} - at most once per frame, only on change
+				load.progress = current;
+				CharString path_utf8 = load.path.utf8();
+				for (uint32_t j = 0; j < load.subscribers.size(); j++) {
+					ei_x_buff message;
+					ei_x_new_with_version(&message);
+					ei_x_encode_tuple_header(&message, 3);
+					ei_x_encode_atom(&message, "load_progress");
+					ei_x_encode_string(&message, path_utf8.get_data());
+					ei_x_encode_double(&message, current);
+					send_message(load.subscribers[j].fd, &load.subscribers[j].pid, &message);
+					ei_x_free(&message);
 				}
 			}
-			ei_x_free(&x);
-			/* Give additional time for reply to be fully transmitted before closing */
-			usleep(200000); // 200ms - increased from 100ms
-			close(fd);
+			i++;
 			continue;
-		} else {
-			struct timeval receive_time;
-			gettimeofday(&receive_time, NULL);
-			long elapsed_us = (receive_time.tv_sec - wait_start.tv_sec) * 1000000 + (receive_time.tv_usec - wait_start.tv_usec);
-			printf(" (success, elapsed: %ld us)\n", elapsed_us);
 		}
 
-		printf("Godot CNode: Message type: %ld\n", msg.msgtype);
-
-		/* Process the message */
-		x.index = 0;
-		int process_result = process_message(x.buff, &x.index, fd);
-		if (process_result < 0) {
-			fprintf(stderr, "Error processing message\n");
+		// A failed load is collected too, or the loader keeps its task; an invalid one has no task
+		Ref<Resource> resource;
+		if (status != ResourceLoader::THREAD_LOAD_INVALID_RESOURCE) {
+			resource = loader->load_threaded_get(load.path);
+		}
+		if (resource.is_valid()) {
+			// Hold a reference so the ID sent to the client stays valid until unload
+			loaded_resources.insert(load.path, resource);
+			Ref<PackedScene> scene = resource;
+			if (scene.is_valid()) {
+				scene_cache.insert(load.path, scene);
+			}
+		}
+		for (uint32_t j = 0; j < load.subscribers.size(); j++) {
+			_send_load_result(load.subscribers[j], load.path, resource);
 		}
+		resource_loads.remove_at_unordered(i);
+	}
+}
 
-		/* For GenServer calls, give time for reply to be sent */
-		if (process_result == 0) {
-			/* Longer delay to ensure reply is fully sent and received for GenServer calls */
-			usleep(200000); // 200ms - increased from 50ms
+uint64_t CNodeServer::start_nav_path_job(int fd, const erlang_pid &pid, const erlang_ref &tag, const RID &map, const PackedFloat32Array &queries, bool optimize, int batch) {
+	NavPathJob job;
+	job.id = next_job_id++;
+	job.fd = fd;
+	job.pid = pid;
+	job.tag = tag;
+	job.map = map;
+	job.queries = queries;
+	job.optimize = optimize;
+	job.batch = batch;
+	nav_path_jobs.push_back(job);
+	return job.id;
+}
+
+void CNodeServer::_process_nav_path_jobs() {
+	for (uint32_t i = 0; i < nav_path_jobs.size();) {
+		NavPathJob &job = nav_path_jobs[i];
+		uint32_t total = job.queries.size() / 7;
+		uint32_t from = job.offsets.size();
+		uint32_t to = MIN(from + (uint32_t)job.batch, total);
+		run_nav_path_queries(job.map, job.queries, from, to, job.optimize, job.offsets, job.points);
+		if (to < total) {
+			i++;
+			continue;
 		}
 
-		/* Process multiple messages on the same connection */
-		/* According to Erlang distribution protocol, multiple messages can be sent on the same connection */
-		/* Continue receiving messages until select() times out or connection closes */
-		printf("Godot CNode: Checking for more messages on this connection...\n");
-		fflush(stdout);
+		// {nav_paths, JobId, Binary}
+		ei_x_buff message;
+		ei_x_new_with_version(&message);
+		ei_x_encode_tuple_header(&message, 3);
+		ei_x_encode_atom(&message, "nav_paths");
+		ei_x_encode_ulonglong(&message, job.id);
+		encode_nav_paths(job.offsets, job.points, &message);
+		send_message(job.fd, &job.pid, &message);
+		ei_x_free(&message);
+		nav_path_jobs.remove_at(i);
+	}
+}
 
-		/* Free the current buffer and prepare for next message */
-		ei_x_free(&x);
-		ei_x_new(&x);
+bool CNodeServer::multimesh_set_buffer(MultiMesh *multimesh, const PackedFloat32Array &buffer) {
+	if (buffer.size() != (int64_t)multimesh->get_instance_count() * multimesh_stride(multimesh)) {
+		return false;
+	}
+	RenderingServer::get_singleton()->multimesh_set_buffer(multimesh->get_rid(), buffer);
 
-		/* Check if more data is available with a short timeout */
-		FD_ZERO(&recv_fds);
-		FD_SET(fd, &recv_fds);
-		recv_timeout.tv_sec = 0; /* No wait - check immediately */
-		recv_timeout.tv_usec = 100000; /* 100ms */
-		select_res = select(fd + 1, &recv_fds, NULL, NULL, &recv_timeout);
-		if (select_res > 0 && FD_ISSET(fd, &recv_fds)) {
-			/* More data available - continue processing */
-			printf("Godot CNode: More data available, continuing to receive...\n");
-			fflush(stdout);
-			continue; /* Go back to receive next message */
-		} else {
-			/* No more data - close connection */
-			printf("Godot CNode: No more data available, closing connection\n");
-			fflush(stdout);
-			ei_x_free(&x);
-			close(fd);
+	// Keep a streaming shadow in sync (shares the array until the next range update writes to it)
+	MultiMeshShadow *shadow = multimesh_shadows.getptr(multimesh->get_instance_id());
+	if (shadow != nullptr) {
+		shadow->buffer = buffer;
+		shadow->dirty = false;
+	}
+	return true;
+}
+
+bool CNodeServer::multimesh_update(MultiMesh *multimesh, int64_t first_instance, const PackedFloat32Array &values) {
+	int stride = multimesh_stride(multimesh);
+	int64_t buffer_size = (int64_t)multimesh->get_instance_count() * stride;
+	int64_t offset = first_instance * stride;
+	if (first_instance < 0 || values.size() % stride != 0 || offset + values.size() > buffer_size) {
+		return false;
+	}
+
+	uint64_t key = multimesh->get_instance_id();
+	MultiMeshShadow *shadow = multimesh_shadows.getptr(key);
+	if (shadow == nullptr || shadow->buffer.size() != buffer_size) {
+		// First range for this MultiMesh, or its instance count changed
+		MultiMeshShadow fresh;
+		fresh.buffer = RenderingServer::get_singleton()->multimesh_get_buffer(multimesh->get_rid());
+		fresh.dirty = false;
+		if (fresh.buffer.size() != buffer_size) {
+			fresh.buffer.resize(buffer_size);
+		}
+		multimesh_shadows.insert(key, fresh);
+		shadow = multimesh_shadows.getptr(key);
+	}
+	memcpy(shadow->buffer.ptrw() + offset, values.ptr(), values.size() * sizeof(float));
+	shadow->dirty = true;
+	return true;
+}
+
+void CNodeServer::_flush_multimesh_updates() {
+	// All ranges received this frame go up in one multimesh_set_buffer per MultiMesh
+	LocalVector<uint64_t> stale;
+	for (KeyValue<uint64_t, MultiMeshShadow> &E : multimesh_shadows) {
+		MultiMesh *multimesh = Object::cast_to<MultiMesh>(ObjectDB::get_instance(E.key));
+		if (multimesh == nullptr) {
+			stale.push_back(E.key);
+			continue;
+		}
+		if (!E.value.dirty) {
+			continue;
 		}
+		RenderingServer::get_singleton()->multimesh_set_buffer(multimesh->get_rid(), E.value.buffer);
+		E.value.dirty = false;
+	}
+	for (uint32_t i = 0; i < stale.size(); i++) {
+		multimesh_shadows.erase(stale[i]);
+	}
+}
+
+void CNodeServer::create_rid_instances(int fd, const RID &base, const RID &scenario, int count, LocalVector<uint32_t> &r_handles) {
+	RenderingServer *rs = RenderingServer::get_singleton();
+	r_handles.reserve(r_handles.size() + count);
+	for (int i = 0; i < count; i++) {
+		r_handles.push_back(_add_rid_handle(rs->instance_create2(base, scenario), RID_KIND_INSTANCE, fd));
+	}
+}
+
+void CNodeServer::create_rid_bodies(int fd, const RID &shape, const RID &space, int mode, int count, LocalVector<uint32_t> &r_handles) {
+	PhysicsServer3D *ps = PhysicsServer3D::get_singleton();
+	r_handles.reserve(r_handles.size() + count);
+	for (int i = 0; i < count; i++) {
+		RID body = ps->body_create();
+		ps->body_set_mode(body, (PhysicsServer3D::BodyMode)mode);
+		ps->body_add_shape(body, shape);
+		ps->body_set_space(body, space);
+		r_handles.push_back(_add_rid_handle(body, RID_KIND_BODY, fd));
 	}
+}
 
-	ei_x_free(&x);
+uint32_t CNodeServer::_add_rid_handle(const RID &rid, RidKind kind, int fd) {
+	uint32_t slot;
+	if (!free_rid_handles.is_empty()) {
+		slot = free_rid_handles[free_rid_handles.size() - 1];
+		free_rid_handles.remove_at(free_rid_handles.size() - 1);
+	} else {
+		ERR_FAIL_COND_V_MSG(rid_handles.size() >= CNodeObjectHandles::INDEX_MASK, 0, "Godot CNode: RID handle table is full");
+		slot = rid_handles.size();
+		RidHandle fresh;
+		fresh.kind = RID_KIND_FREE;
+		fresh.fd = -1;
+		fresh.generation = 0;
+		rid_handles.push_back(fresh);
+	}
+	RidHandle &entry = rid_handles[slot];
+	entry.rid = rid;
+	entry.kind = kind;
+	entry.fd = fd;
+	return (entry.generation << CNodeObjectHandles::INDEX_BITS) | (slot + 1);
 }
-} // extern "C" - closes main_loop's extern "C" block
 
-/*
- * Non-blocking version of main_loop for use in Godot's main thread
- * Processes one connection or message per call, returns immediately if nothing available
- * Returns: 0 = processed something, 1 = nothing to process, -1 = error/shutdown
- */
-extern "C" {
-int process_cnode_frame(void) {
-	static ei_x_buff x;
-	static erlang_msg msg;
-	static int current_fd = -1;
-	static bool x_initialized = false;
+CNodeServer::RidHandle *CNodeServer::_get_rid_handle(int fd, uint32_t handle) {
+	uint32_t index = handle & CNodeObjectHandles::INDEX_MASK;
+	if (index == 0 || index > rid_handles.size()) {
+		return nullptr;
+	}
+	RidHandle &entry = rid_handles[index - 1];
+	if (entry.kind == RID_KIND_FREE || entry.fd != fd || entry.generation != (handle >> CNodeObjectHandles::INDEX_BITS)) {
+		return nullptr;
+	}
+	return &entry;
+}
 
-	// Initialize buffer on first call
-	if (!x_initialized) {
-		ei_x_new(&x);
-		x_initialized = true;
+void CNodeServer::_free_rid_slot(uint32_t slot) {
+	RidHandle &entry = rid_handles[slot];
+	switch (entry.kind) {
+		case RID_KIND_INSTANCE:
+			RenderingServer::get_singleton()->free_rid(entry.rid);
+			break;
+		case RID_KIND_BODY:
+			PhysicsServer3D::get_singleton()->free_rid(entry.rid);
+			break;
+		default:
+			return;
 	}
+	entry.rid = RID();
+	entry.kind = RID_KIND_FREE;
+	entry.fd = -1;
+	entry.generation = (entry.generation + 1) & CNodeObjectHandles::GENERATION_MASK;
+	free_rid_handles.push_back(slot);
+}
 
-	// Check if listen_fd is valid
-	if (listen_fd < 0) {
-		return -1; // Shutdown
+bool CNodeServer::set_rid_transform(int fd, uint32_t handle, const Transform3D &transform) {
+	const RidHandle *entry = _get_rid_handle(fd, handle);
+	if (entry == nullptr) {
+		return false;
+	}
+	if (entry->kind == RID_KIND_INSTANCE) {
+		RenderingServer::get_singleton()->instance_set_transform(entry->rid, transform);
+	} else {
+		PhysicsServer3D::get_singleton()->body_set_state(entry->rid, PhysicsServer3D::BODY_STATE_TRANSFORM, transform);
 	}
+	return true;
+}
 
-	// If we have an active connection, try to process messages on it first
-	if (current_fd >= 0) {
-		// Check if more data is available with zero timeout (non-blocking)
-		fd_set recv_fds;
-		struct timeval recv_timeout;
-		FD_ZERO(&recv_fds);
-		FD_SET(current_fd, &recv_fds);
-		recv_timeout.tv_sec = 0;
-		recv_timeout.tv_usec = 0; // Zero timeout = non-blocking
-		int select_res = select(current_fd + 1, &recv_fds, NULL, NULL, &recv_timeout);
-
-		if (select_res > 0 && FD_ISSET(current_fd, &recv_fds)) {
-			// Data available - try to receive message
-			int res = ei_receive_msg(current_fd, &msg, &x);
-
-			if (res == ERL_TICK) {
-				// Just a tick, continue
-				return 1; // Nothing to process
-			} else if (res == ERL_ERROR) {
-				// Error or connection closed
-				int saved_errno = errno;
-				if (saved_errno == 42 || saved_errno == ENOPROTOOPT) {
-					// macOS compatibility - try to process from buffer
-					if (x.index > 0) {
-						x.index = 0;
-						if (process_message(x.buff, &x.index, current_fd) >= 0) {
-							ei_x_free(&x);
-							ei_x_new(&x);
-							return 0; // Processed message
-						}
-					}
-				}
-				// Connection closed or error - close and reset
-				close(current_fd);
-				current_fd = -1;
-				ei_x_free(&x);
-				ei_x_new(&x);
-				return 1; // Nothing more to process
-			} else if (res == ERL_MSG) {
-				// Message received - process it
-				x.index = 0;
-				int process_result = process_message(x.buff, &x.index, current_fd);
-
-				// Free buffer and prepare for next message
-				ei_x_free(&x);
-				ei_x_new(&x);
-
-				if (process_result < 0) {
-					// Error processing - close connection
-					close(current_fd);
-					current_fd = -1;
-					return -1;
-				}
+bool CNodeServer::free_rid_handle(int fd, uint32_t handle) {
+	if (_get_rid_handle(fd, handle) == nullptr) {
+		return false;
+	}
+	_free_rid_slot((handle & CNodeObjectHandles::INDEX_MASK) - 1);
+	return true;
+}
 
-				return 0; // Processed message
+Node *CNodeServer::find_node_cached(Node *root, const String &path) {
+	HashMap<String, ObjectID> *paths = node_path_cache.getptr(root->get_instance_id());
+	if (paths != nullptr) {
+		const ObjectID *cached = paths->getptr(path);
+		if (cached != nullptr) {
+			Node *node = Object::cast_to<Node>(ObjectDB::get_instance(*cached));
+			if (node != nullptr) {
+				return node;
 			}
-		} else if (select_res == 0) {
-			// No data available - check if connection is still alive
-			// For now, keep connection open for next frame
-			return 1; // Nothing to process this frame
-		} else {
-			// select() error - close connection
-			close(current_fd);
-			current_fd = -1;
-			ei_x_free(&x);
-			ei_x_new(&x);
-			return 1;
 		}
 	}
 
-	// No active connection - check for new connections (non-blocking)
-	fd_set read_fds;
-	struct timeval timeout;
-	FD_ZERO(&read_fds);
-	FD_SET(listen_fd, &read_fds);
-	timeout.tv_sec = 0;
-	timeout.tv_usec = 0; // Zero timeout = non-blocking
+	Node *node = root->get_node_or_null(NodePath(path));
+	// Misses are not cached, a node added later may fill the path. Unique names (%Name) are not
+	// either, a rename elsewhere in the owner's scene can move them to another node
+	if (node == nullptr || path.contains("%")) {
+		return node;
+	}
 
-	int select_res = select(listen_fd + 1, &read_fds, NULL, NULL, &timeout);
+	SceneTree *tree = root->get_tree();
+	if (tree == nullptr) {
+		return node;
+	}
+	Callable removed = Callable(this, "_on_cached_node_removed");
+	if (!tree->is_connected("node_removed", removed)) {
+		tree->connect("node_removed", removed);
+		tree->connect("node_renamed", Callable(this, "_on_cached_node_renamed"));
+	}
+	if (node_path_cache_size >= NODE_PATH_CACHE_LIMIT) {
+		_clear_node_path_cache();
+		paths = nullptr;
+	}
+	if (paths == nullptr) {
+		paths = &node_path_cache.insert(root->get_instance_id(), HashMap<String, ObjectID>())->value;
+	}
+	const ObjectID *stale = paths->getptr(path);
+	if (stale == nullptr) {
+		node_path_cache_size++;
+	} else {
+		// Its node was freed without leaving a tree
+		int *refs = node_path_targets.getptr((uint64_t)*stale);
+		if (refs != nullptr && --(*refs) == 0) {
+			node_path_targets.erase((uint64_t)*stale);
+		}
+	}
+	paths->insert(path, ObjectID(node->get_instance_id()));
+	node_path_targets[node->get_instance_id()]++;
+	return node;
+}
 
-	if (select_res > 0 && FD_ISSET(listen_fd, &read_fds)) {
-		// New connection available - accept it
-		ErlConnect con;
-		int fd = ei_accept(&ec, listen_fd, &con);
+void CNodeServer::_clear_node_path_cache() {
+	node_path_cache.clear();
+	node_path_targets.clear();
+	node_path_cache_size = 0;
+}
 
-		if (fd >= 0) {
-			printf("Godot CNode: ✓ Accepted connection on fd: %d\n", fd);
-			fflush(stdout);
-			if (con.nodename[0] != '\0') {
-				printf("Godot CNode: Connected from node: %s\n", con.nodename);
-				fflush(stdout);
+void CNodeServer::_drop_node_paths(Node *node, bool descendants) {
+	for (KeyValue<uint64_t, HashMap<String, ObjectID>> &E : node_path_cache) {
+		LocalVector<String> dropped;
+		for (const KeyValue<String, ObjectID> &entry : E.value) {
+			Node *cached = Object::cast_to<Node>(ObjectDB::get_instance(entry.value));
+			if (cached == node || (descendants && cached != nullptr && node->is_ancestor_of(cached))) {
+				dropped.push_back(entry.key);
 			}
-
-			// Register global name "godot_server" so Erlang processes can send messages to it
-			// This must be done after accepting a connection (global names require a connection to an Erlang node)
-			// According to: https://www.erlang.org/doc/apps/erl_interface/ei_users_guide.html#using-global-names
-			static bool name_registered = false;
-			if (!name_registered) {
-				erlang_pid *self_pid = ei_self(&ec);
-				if (self_pid != nullptr && ei_global_register(fd, "godot_server", self_pid) == 0) {
-					printf("Godot CNode: ✓ Registered global name 'godot_server'\n");
-					fflush(stdout);
-					name_registered = true;
-				} else {
-					fprintf(stderr, "Godot CNode: Warning: Failed to register global name 'godot_server' (errno: %d, %s)\n", errno, strerror(errno));
-					fflush(stderr);
-				}
+		}
+		for (uint32_t i = 0; i < dropped.size(); i++) {
+			uint64_t target = (uint64_t)E.value[dropped[i]];
+			int *refs = node_path_targets.getptr(target);
+			if (refs != nullptr && --(*refs) == 0) {
+				node_path_targets.erase(target);
 			}
+			E.value.erase(dropped[i]);
+			node_path_cache_size--;
+		}
+	}
+}
 
-			// Store connection for next frame
-			current_fd = fd;
-
-			// Check if data is immediately available
-			FD_ZERO(&read_fds);
-			FD_SET(fd, &read_fds);
-			timeout.tv_sec = 0;
-			timeout.tv_usec = 0;
-			select_res = select(fd + 1, &read_fds, NULL, NULL, &timeout);
-
-			if (select_res > 0 && FD_ISSET(fd, &read_fds)) {
-				// Data immediately available - process it
-				int res = ei_receive_msg(fd, &msg, &x);
+void CNodeServer::_on_cached_node_removed(Node *node) {
+	// Every node of a removed subtree is reported on its own, so only entries for this node are affected.
+	// Most removals (freed projectiles, enemies) hit no entry and cost one lookup
+	if (node_path_targets.has(node->get_instance_id())) {
+		_drop_node_paths(node, false);
+	}
+}
 
-				if (res == ERL_MSG) {
-					x.index = 0;
-					int process_result = process_message(x.buff, &x.index, fd);
-					ei_x_free(&x);
-					ei_x_new(&x);
+void CNodeServer::_on_cached_node_renamed(Node *node) {
+	// A rename changes the path of the whole subtree but is reported once
+	if (node_path_cache_size > 0) {
+		_drop_node_paths(node, true);
+	}
+}
 
-					if (process_result < 0) {
-						close(fd);
-						current_fd = -1;
-						return -1;
-					}
+const HashMap<StringName, Variant::Type> &CNodeServer::get_class_property_types(const String &class_name) {
+	HashMap<String, HashMap<StringName, Variant::Type>>::Iterator existing = class_property_types.find(class_name);
+	if (existing != class_property_types.end()) {
+		return existing->value;
+	}
 
-					return 0; // Processed message
-				} else if (res == ERL_TICK) {
-					return 1; // Just a tick
-				} else {
-					// Error - close connection
-					close(fd);
-					current_fd = -1;
-					return 1;
-				}
-			}
+	HashMap<StringName, Variant::Type> types;
+	TypedArray<Dictionary> properties = ClassDBSingleton::get_singleton()->class_get_property_list(class_name);
+	for (int64_t i = 0; i < properties.size(); i++) {
+		Dictionary property = properties[i];
+		types.insert(property["name"].operator StringName(), (Variant::Type)property["type"].operator int64_t());
+	}
+	return class_property_types.insert(class_name, types)->value;
+}
 
-			return 0; // Accepted connection
-		} else {
-			// Accept failed - but not critical, just try again next frame
-			int saved_errno = errno;
-			if (saved_errno == EBADF || saved_errno == 9) {
-				// Socket closed - shutdown
-				return -1;
-			}
-			// Other errors - just try again next frame
-			return 1;
+CNodeClassMetadata &CNodeServer::get_class_metadata() {
+	if (!class_metadata.is_loaded()) {
+		uint64_t hash = CNodeClassMetadata::compute_hash();
+		if (!class_metadata.map_snapshot(CLASS_SNAPSHOT_PATH, hash)) {
+			class_metadata.build_snapshot(CLASS_SNAPSHOT_PATH, hash);
 		}
 	}
-
-	// Nothing to process this frame
-	return 1;
+	return class_metadata;
 }
-} // extern "C"
 
-// CNodeServer Node class implementation
-namespace godot {
+void CNodeServer::keep_created_object(int fd, const Variant &object) {
+	if (!created_objects.has(fd)) {
+		created_objects.insert(fd, LocalVector<Variant>());
+	}
+	created_objects[fd].push_back(object);
+}
 
-void CNodeServer::_bind_methods() {
-	ClassDB::bind_method(D_METHOD("_add_to_scene_tree"), &CNodeServer::_add_to_scene_tree);
+void CNodeServer::set_prefetch(int fd, const CNodePrefetchSpec &spec) {
+	if (spec.classes.is_empty()) {
+		prefetch_specs.erase(fd);
+	} else {
+		prefetch_specs.insert(fd, spec);
+	}
+	// The reply to this call is encoded with the new spec
+	if (fd == current_request_fd) {
+		active_prefetch = get_prefetch(fd);
+	}
 }
 
-CNodeServer::CNodeServer() : initialized(false), cookie_copy(nullptr) {
+const CNodePrefetchSpec *CNodeServer::get_prefetch(int fd) {
+	return prefetch_specs.getptr(fd);
 }
 
-CNodeServer::~CNodeServer() {
-	// Cleanup: close listen_fd if still open
-	if (listen_fd >= 0) {
-		close(listen_fd);
-		listen_fd = -1;
+void CNodeServer::set_object_handles(int fd, bool enabled) {
+	if (!enabled) {
+		object_handles.erase(fd);
+	} else if (!object_handles.has(fd)) {
+		object_handles.insert(fd, CNodeObjectHandles());
 	}
+}
 
-	// Clean up cookie string
-	if (cookie_copy != nullptr) {
-		delete[] cookie_copy;
-		cookie_copy = nullptr;
-	}
+CNodeObjectHandles *CNodeServer::get_object_handles(int fd) {
+	return object_handles.getptr(fd);
 }
 
-void CNodeServer::_add_to_scene_tree() {
-	// Add this node to the scene tree
-	Engine *engine = Engine::get_singleton();
-	if (engine == nullptr) {
-		UtilityFunctions::printerr("Godot CNode: Engine not available in _add_to_scene_tree");
-		return;
+void CNodeServer::object_freed(ObjectID id) {
+	for (KeyValue<int, CNodeObjectHandles> &E : object_handles) {
+		E.value.invalidate(id);
 	}
+}
 
-	MainLoop *main_loop = engine->get_main_loop();
-	if (main_loop == nullptr) {
-		UtilityFunctions::printerr("Godot CNode: Main loop not available in _add_to_scene_tree");
-		return;
+void CNodeServer::connection_closed(int fd) {
+	for (uint32_t i = 0; i < tree_watchers.size();) {
+		if (tree_watchers[i].fd == fd) {
+			ei_x_free(&tree_watchers[i].pending);
+			tree_watchers.remove_at_unordered(i);
+		} else {
+			i++;
+		}
 	}
-
-	SceneTree *scene_tree = Object::cast_to<SceneTree>(main_loop);
-	if (scene_tree == nullptr) {
-		UtilityFunctions::printerr("Godot CNode: SceneTree not available in _add_to_scene_tree");
-		return;
+	_update_tree_signals();
+
+	// Loads keep running for other subscribers, and still fill the cache otherwise
+	for (uint32_t i = 0; i < resource_loads.size(); i++) {
+		LocalVector<ResourceSubscriber> &subscribers = resource_loads[i].subscribers;
+		for (uint32_t j = 0; j < subscribers.size();) {
+			if (subscribers[j].fd == fd) {
+				subscribers.remove_at_unordered(j);
+			} else {
+				j++;
+			}
+		}
 	}
 
-	// Add to root window
-	Window *root = scene_tree->get_root();
-	if (root != nullptr && get_parent() == nullptr) {
-		root->add_child(this);
-		UtilityFunctions::print("Godot CNode: CNodeServer node added to root window");
-	} else if (get_parent() == nullptr) {
-		// Try current scene as fallback
-		Node *current_scene = scene_tree->get_current_scene();
-		if (current_scene != nullptr) {
-			current_scene->add_child(this);
-			UtilityFunctions::print("Godot CNode: CNodeServer node added to current scene");
+	// Path queries are only useful to the client that asked
+	for (uint32_t i = 0; i < nav_path_jobs.size();) {
+		if (nav_path_jobs[i].fd == fd) {
+			nav_path_jobs.remove_at(i);
 		} else {
-			UtilityFunctions::printerr("Godot CNode: Could not add CNodeServer node to scene tree");
+			i++;
 		}
 	}
-}
-
-void CNodeServer::_ready() {
-	// Initialize CNode on main thread
-	UtilityFunctions::print("Godot CNode: CNodeServer node ready, initializing CNode...");
 
-	// Get cookie from environment or use default
-	String cookie;
-	OS *os = OS::get_singleton();
-	if (os) {
-		String env_cookie = os->get_environment("GODOT_CNODE_COOKIE");
-		if (!env_cookie.is_empty()) {
-			cookie = env_cookie.strip_edges();
-			UtilityFunctions::print("Godot CNode: Using cookie from GODOT_CNODE_COOKIE environment variable");
+	// Nobody is left to receive deferred replies; their waiters find them gone
+	LocalVector<uint64_t> orphaned;
+	for (const KeyValue<uint64_t, PendingReply> &E : pending_replies) {
+		if (E.value.target.fd == fd) {
+			orphaned.push_back(E.key);
 		}
 	}
+	for (uint32_t i = 0; i < orphaned.size(); i++) {
+		pending_replies.erase(orphaned[i]);
+	}
+	_prune_signal_waits();
 
-	if (cookie.is_empty()) {
-		// Use default cookie
-		cookie = "godotcookie";
-		UtilityFunctions::print("Godot CNode: Using default cookie");
+	// A simulation driven by this client must not stay frozen waiting for it
+	if (lockstep && lockstep_fd == fd) {
+		set_lockstep(-1, false);
 	}
 
-	// Store cookie as C string
-	size_t cookie_len = cookie.length();
-	cookie_copy = new char[cookie_len + 1];
-	memcpy(cookie_copy, cookie.utf8().get_data(), cookie_len);
-	cookie_copy[cookie_len] = '\0';
+	object_handles.erase(fd);
+	prefetch_specs.erase(fd);
+	created_objects.erase(fd);
 
-	// Initialize instances array
-	memset(instances, 0, sizeof(instances));
+	// Instances it took detached and never attached or released have no other owner
+	LocalVector<uint64_t> owned;
+	for (const KeyValue<uint64_t, int> &E : detached_instances) {
+		if (E.value == fd) {
+			owned.push_back(E.key);
+		}
+	}
+	for (uint32_t i = 0; i < owned.size(); i++) {
+		detached_instances.erase(owned[i]);
+		Node *node = Object::cast_to<Node>(ObjectDB::get_instance(ObjectID(owned[i])));
+		if (node != nullptr && node->get_parent() == nullptr) {
+			memdelete(node);
+		}
+	}
 
-	// Try different hostname options
-	char hostname[256] = { 0 };
-	char nodename[512] = { 0 };
-	const char *nodename_options[4];
-	int option_count = 0;
+	// Queued messages and unsent replies have nowhere to go, and the descriptor number may be reused
+	scheduler.remove_peer(fd);
 
-	nodename_options[option_count++] = "godot@127.0.0.1";
-	nodename_options[option_count++] = "godot@localhost";
+	// Scene-less RIDs have no other owner
+	for (uint32_t i = 0; i < rid_handles.size(); i++) {
+		if (rid_handles[i].kind != RID_KIND_FREE && rid_handles[i].fd == fd) {
+			_free_rid_slot(i);
+		}
+	}
 
-#ifndef _WIN32
-	if (gethostname(hostname, sizeof(hostname) - 1) == 0) {
-		if (strlen(hostname) > 6 && strcmp(hostname + strlen(hostname) - 6, ".local") != 0) {
-			snprintf(nodename, sizeof(nodename), "godot@%s", hostname);
-			nodename_options[option_count++] = nodename;
+	// Spawn jobs keep running (the nodes are wanted), but nobody is left to notify
+	for (uint32_t i = 0; i < spawn_jobs.size(); i++) {
+		if (spawn_jobs[i].fd == fd) {
+			spawn_jobs[i].fd = -1;
 		}
 	}
-#endif
-	nodename_options[option_count] = nullptr;
+}
 
-	bool init_success = false;
-	for (int i = 0; nodename_options[i] != nullptr; i++) {
-		if (init_cnode(const_cast<char *>(nodename_options[i]), cookie_copy) == 0) {
-			init_success = true;
-			UtilityFunctions::print(String("Godot CNode: Successfully initialized with ") + nodename_options[i]);
-			break;
+int CNodeServer::cancel_requests(const erlang_ref *tag, uint64_t job_id) {
+	int cancelled = 0;
+
+	if (tag != nullptr) {
+		// Scheduled calls are answered now instead of on their frame
+		LocalVector<CNodeTimerWheel::Entry> removed;
+		physics_wheel.cancel(*tag, removed);
+		idle_wheel.cancel(*tag, removed);
+		for (uint32_t i = 0; i < removed.size(); i++) {
+			ei_x_buff reply;
+			ei_x_new(&reply);
+			ei_x_encode_tuple_header(&reply, 2);
+			ei_x_encode_atom(&reply, "error");
+			ei_x_encode_string(&reply, "cancelled");
+			send_reply(&reply, removed[i].reply_to.fd, &removed[i].reply_to.pid, &removed[i].reply_to.tag);
+			ei_x_free(&reply);
+		}
+		cancelled += removed.size();
+
+		// Calls still waiting in a connection's lane never run
+		LocalVector<CNodeReplyTarget> queued_calls;
+		scheduler.remove_calls(*tag, queued_calls);
+		for (uint32_t i = 0; i < queued_calls.size(); i++) {
+			ei_x_buff reply;
+			ei_x_new(&reply);
+			ei_x_encode_tuple_header(&reply, 2);
+			ei_x_encode_atom(&reply, "error");
+			ei_x_encode_string(&reply, "cancelled");
+			send_reply(&reply, queued_calls[i].fd, &queued_calls[i].pid, &queued_calls[i].tag);
+			ei_x_free(&reply);
+		}
+		cancelled += queued_calls.size();
+
+		// Deferred replies; whatever completes them later finds them gone
+		LocalVector<uint64_t> waiting;
+		for (const KeyValue<uint64_t, PendingReply> &E : pending_replies) {
+			if (same_ref(E.value.target.tag, *tag)) {
+				waiting.push_back(E.key);
+			}
+		}
+		for (uint32_t i = 0; i < waiting.size(); i++) {
+			ei_x_buff reply;
+			ei_x_new(&reply);
+			ei_x_encode_tuple_header(&reply, 2);
+			ei_x_encode_atom(&reply, "error");
+			ei_x_encode_string(&reply, "cancelled");
+			complete_reply(waiting[i], &reply);
+			ei_x_free(&reply);
+		}
+		cancelled += waiting.size();
+		_prune_signal_waits();
+
+		// The load itself cannot be stopped and still fills the cache; the caller just stops hearing about it
+		for (uint32_t i = 0; i < resource_loads.size(); i++) {
+			LocalVector<ResourceSubscriber> &subscribers = resource_loads[i].subscribers;
+			for (uint32_t j = 0; j < subscribers.size();) {
+				if (same_ref(subscribers[j].tag, *tag)) {
+					subscribers.remove_at_unordered(j);
+					cancelled++;
+				} else {
+					j++;
+				}
+			}
 		}
 	}
 
-	if (!init_success) {
-		UtilityFunctions::printerr("Godot CNode: Failed to initialize CNode with all hostname options");
-		return;
+	// Multi-frame jobs stop before their next batch and report {cancelled, JobId}
+	// A spawn is undone: the nodes of the batches already in are freed
+	for (uint32_t i = 0; i < spawn_jobs.size();) {
+		SpawnJob &job = spawn_jobs[i];
+		if (job.id != job_id && (tag == nullptr || !same_ref(job.tag, *tag))) {
+			i++;
+			continue;
+		}
+		for (uint32_t j = 0; j < job.ids.size(); j++) {
+			Node *node = Object::cast_to<Node>(ObjectDB::get_instance(job.ids[j]));
+			if (node != nullptr && job.entries[j].parent < 0) {
+				node->queue_free();
+			}
+		}
+		if (job.fd >= 0) {
+			ei_x_buff message;
+			ei_x_new_with_version(&message);
+			ei_x_encode_tuple_header(&message, 2);
+			ei_x_encode_atom(&message, "cancelled");
+			ei_x_encode_ulonglong(&message, job.id);
+			send_message(job.fd, &job.pid, &message);
+			ei_x_free(&message);
+		}
+		spawn_jobs.remove_at(i);
+		cancelled++;
 	}
+	for (uint32_t i = 0; i < nav_path_jobs.size();) {
+		NavPathJob &job = nav_path_jobs[i];
+		if (job.id != job_id && (tag == nullptr || !same_ref(job.tag, *tag))) {
+			i++;
+			continue;
+		}
+		ei_x_buff message;
+		ei_x_new_with_version(&message);
+		ei_x_encode_tuple_header(&message, 2);
+		ei_x_encode_atom(&message, "cancelled");
+		ei_x_encode_ulonglong(&message, job.id);
+		send_message(job.fd, &job.pid, &message);
+		ei_x_free(&message);
+		nav_path_jobs.remove_at(i);
+		cancelled++;
+	}
+	return cancelled;
+}
 
-	initialized = true;
-	UtilityFunctions::print(String("Godot CNode: CNodeServer initialized and ready (listen_fd: ") + itos(listen_fd) + ")");
+void CNodeServer::watch_tree(int fd, const erlang_pid &pid, Node *root) {
+	// One subscription per PID - watching again moves it to the new root
+	unwatch_tree(pid);
+
+	TreeWatcher watcher;
+	watcher.fd = fd;
+	watcher.pid = pid;
+	watcher.root = root->get_instance_id();
+	watcher.pending_count = 0;
+	ei_x_new(&watcher.pending);
+	tree_watchers.push_back(watcher);
+	_update_tree_signals();
 }
 
-void CNodeServer::_process(double delta) {
-	if (!initialized || listen_fd < 0) {
+void CNodeServer::unwatch_tree(const erlang_pid &pid) {
+	for (uint32_t i = 0; i < tree_watchers.size(); i++) {
+		const erlang_pid &watched = tree_watchers[i].pid;
+		if (watched.num == pid.num && watched.serial == pid.serial && watched.creation == pid.creation && strcmp(watched.node, pid.node) == 0) {
+			ei_x_free(&tree_watchers[i].pending);
+			tree_watchers.remove_at_unordered(i);
+			break;
+		}
+	}
+	_update_tree_signals();
+}
+
+void CNodeServer::_update_tree_signals() {
+	SceneTree *tree = get_tree();
+	if (tree == nullptr) {
 		return;
 	}
+	Callable added = Callable(this, "_on_tree_node_added");
+	Callable removed = Callable(this, "_on_tree_node_removed");
+	Callable renamed = Callable(this, "_on_tree_node_renamed");
+	bool connected = tree->is_connected("node_added", added);
+
+	// Only pay for the signals while somebody is watching
+	if (!tree_watchers.is_empty() && !connected) {
+		tree->connect("node_added", added);
+		tree->connect("node_removed", removed);
+		tree->connect("node_renamed", renamed);
+	} else if (tree_watchers.is_empty() && connected) {
+		tree->disconnect("node_added", added);
+		tree->disconnect("node_removed", removed);
+		tree->disconnect("node_renamed", renamed);
+	}
+}
+
+void CNodeServer::_queue_tree_diff(TreeDiffKind kind, Node *node) {
+	// Filter at event time: a removed node is still in the tree while node_removed is emitted
+	for (uint32_t i = 0; i < tree_watchers.size(); i++) {
+		TreeWatcher &watcher = tree_watchers[i];
+		Node *root = Object::cast_to<Node>(ObjectDB::get_instance(watcher.root));
+		if (root == nullptr || (root != node && !root->is_ancestor_of(node))) {
+			continue;
+		}
+
+		CNodeRequestScope scope(watcher.fd);
+		ei_x_buff *x = &watcher.pending;
+		switch (kind) {
+			case TREE_DIFF_ADDED: {
+				Node *parent = node->get_parent();
+				ei_x_encode_tuple_header(x, 5);
+				ei_x_encode_atom(x, "added");
+				ei_x_encode_longlong(x, export_object_ref(node));
+				ei_x_encode_longlong(x, export_object_ref(parent));
+				ei_x_encode_string(x, String(node->get_name()).utf8().get_data());
+				ei_x_encode_string(x, node->get_class().utf8().get_data());
+				break;
+			}
+			case TREE_DIFF_REMOVED:
+				ei_x_encode_tuple_header(x, 2);
+				ei_x_encode_atom(x, "removed");
+				ei_x_encode_longlong(x, export_object_ref(node));
+				break;
+			case TREE_DIFF_RENAMED:
+				ei_x_encode_tuple_header(x, 3);
+				ei_x_encode_atom(x, "renamed");
+				ei_x_encode_longlong(x, export_object_ref(node));
+				ei_x_encode_string(x, String(node->get_name()).utf8().get_data());
+				break;
+		}
+		watcher.pending_count++;
+	}
+}
+
+void CNodeServer::_on_tree_node_added(Node *node) {
+	_queue_tree_diff(TREE_DIFF_ADDED, node);
+}
 
-	// Process one frame of CNode operations (non-blocking)
-	int result = process_cnode_frame();
+void CNodeServer::_on_tree_node_removed(Node *node) {
+	_queue_tree_diff(TREE_DIFF_REMOVED, node);
+}
+
+void CNodeServer::_on_tree_node_renamed(Node *node) {
+	_queue_tree_diff(TREE_DIFF_RENAMED, node);
+}
+
+void CNodeServer::_flush_tree_watchers() {
+	uint64_t frame = Engine::get_singleton()->get_process_frames();
+	for (uint32_t i = 0; i < tree_watchers.size();) {
+		TreeWatcher &watcher = tree_watchers[i];
+		if (watcher.pending_count == 0) {
+			i++;
+			continue;
+		}
 
-	// result: 0 = processed something, 1 = nothing to process, -1 = error/shutdown
-	if (result < 0) {
-		// Error or shutdown
-		UtilityFunctions::printerr("Godot CNode: process_cnode_frame() returned error, shutting down");
-		initialized = false;
+		// {tree_diff, ProcessFrame, [Diff, ...]} - one message per watcher per frame
+		ei_x_buff message;
+		ei_x_new_with_version(&message);
+		ei_x_encode_tuple_header(&message, 3);
+		ei_x_encode_atom(&message, "tree_diff");
+		ei_x_encode_ulonglong(&message, frame);
+		ei_x_encode_list_header(&message, watcher.pending_count);
+		ei_x_append_buf(&message, watcher.pending.buff, watcher.pending.index);
+		ei_x_encode_empty_list(&message);
+		int send_result = send_message(watcher.fd, &watcher.pid, &message);
+		ei_x_free(&message);
+
+		watcher.pending.index = 0;
+		watcher.pending_count = 0;
+		if (send_result < 0) {
+			// Subscriber is gone
+			ei_x_free(&watcher.pending);
+			tree_watchers.remove_at_unordered(i);
+			_update_tree_signals();
+		} else {
+			i++;
+		}
 	}
 }
 
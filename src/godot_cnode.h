@@ -1,10 +1,19 @@
 #pragma once
 
+#include <godot_cpp/classes/multi_mesh.hpp>
 #include <godot_cpp/classes/node.hpp>
+#include <godot_cpp/classes/packed_scene.hpp>
+#include <godot_cpp/classes/ref_counted.hpp>
 #include <godot_cpp/classes/scene_tree.hpp>
 #include <godot_cpp/core/object.hpp>
+#include <godot_cpp/templates/hash_map.hpp>
+#include <godot_cpp/templates/local_vector.hpp>
 #include <godot_cpp/variant/variant.hpp>
 
+extern "C" {
+#include "ei.h"
+}
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -33,22 +42,568 @@ int process_cnode_frame(void); // Non-blocking version for main thread
 
 // CNodeServer Node class - runs on main thread
 namespace godot {
+
+// Where to send the reply of a GenServer call that completes later
+struct CNodeReplyTarget {
+	int fd;
+	erlang_pid pid;
+	erlang_ref tag;
+};
+
+// Hashed timer wheel keyed by frame number
+// Each slot holds the encoded {Module, Function, Args} terms due on frames congruent to the slot index
+class CNodeTimerWheel {
+public:
+	static const int SLOT_COUNT = 256;
+
+	struct Entry {
+		uint64_t target_frame;
+		LocalVector<char> request; // Encoded {Module, Function, Args} term
+		int fd; // Connection the request arrived on
+		uint64_t received_usec; // When the request was read, the start of its relative timeout
+		bool has_reply; // Run as a call answering reply_to, otherwise as a cast
+		CNodeReplyTarget reply_to;
+	};
+
+	CNodeTimerWheel();
+
+	void schedule(uint64_t target_frame, const char *term, int term_len, int fd, const CNodeReplyTarget *reply_to = nullptr);
+	// Moves every entry due on `frame` (or earlier) into `r_due`, in scheduling order
+	void collect_due(uint64_t frame, LocalVector<Entry> &r_due);
+	// Moves every scheduled call answering `tag` into `r_cancelled`
+	void cancel(const erlang_ref &tag, LocalVector<Entry> &r_cancelled);
+	int size() const { return count; }
+
+private:
+	LocalVector<Entry> slots[SLOT_COUNT];
+	uint64_t last_frame; // Last frame collected, entries at or before it are overdue
+	bool started;
+	int count;
+};
+
+// Inbound messages of every connection, waiting to be dispatched on the main thread
+// Each connection has a lane for calls and one for casts, and the lanes are served by deficit
+// round robin: a visit credits weight * QUANTUM_BYTES, spent on messages by their encoded size,
+// so a peer streaming bulk data cannot starve a quiet one sending small control calls
+// Outgoing messages wait per connection until its socket has room, so a slow reader never blocks
+// the main thread; both directions are bounded and a full connection is no longer read from
+class CNodePeerScheduler {
+public:
+	static const int QUANTUM_BYTES = 4096;
+
+	enum Lane {
+		LANE_CALL,
+		LANE_CAST,
+		LANE_MAX,
+	};
+
+	struct Message {
+		int fd;
+		PackedByteArray data; // Encoded message as received
+		uint64_t received_usec;
+	};
+
+	struct Outgoing {
+		PackedByteArray frame; // Complete distribution frame: length, pass-through byte, SEND control, message
+	};
+
+	void set_limits(int inbound_max_messages, int64_t inbound_max_bytes, int64_t outbound_max_bytes);
+	void add_peer(int fd, int weight);
+	void remove_peer(int fd);
+	bool has_peer(int fd) const { return peers.has(fd); }
+	const LocalVector<int> &get_peer_fds() const { return peer_fds; }
+	void enqueue(int fd, Lane lane, const char *data, int size, uint64_t received_usec);
+	// Pops the next message to dispatch; false when all lanes are empty
+	bool next(Message &r_message);
+	// Takes the queued GenServer calls with this tag out of their lanes, for cancel
+	void remove_calls(const erlang_ref &tag, LocalVector<CNodeReplyTarget> &r_removed);
+	int size() const { return queued; }
+
+	// A full connection is not read from until it drains, so TCP backpressure builds up on the sender
+	bool is_inbound_full(int fd) const;
+	bool is_outbound_full(int fd) const;
+	// Queues behind the frames already waiting for the socket; false for unknown connections
+	// Never drops a message: the outbound bound only stops reading and sheds calls
+	bool queue_outbound(int fd, const PackedByteArray &frame);
+	// The unwritten rest of the oldest frame; false if nothing is waiting
+	bool peek_outbound(int fd, const uint8_t *&r_data, int64_t &r_size) const;
+	// Marks bytes of the oldest frame as written, dropping it once complete
+	void consume_outbound(int fd, int64_t bytes);
+	// A frame is partly on the wire; nothing else may write to the socket until it is complete
+	bool is_writing(int fd) const;
+
+	// Largest backlog any single connection reached
+	int get_inbound_high_water() const { return inbound_high_water; }
+	int64_t get_inbound_high_water_bytes() const { return inbound_high_water_bytes; }
+	int64_t get_outbound_high_water_bytes() const { return outbound_high_water_bytes; }
+
+private:
+	struct Peer {
+		int queued = 0; // Inbound, across both lanes
+		int64_t queued_bytes = 0;
+		LocalVector<Outgoing> outbox;
+		uint32_t outbox_head = 0; // First frame not yet fully sent
+		int64_t outbox_offset = 0; // Bytes of that frame already written
+		int64_t outbox_bytes = 0; // Unwritten bytes across all frames
+	};
+
+	struct Flow {
+		int weight = 1;
+		int64_t deficit = 0;
+		bool credited = false; // Quantum added for the current visit
+		bool active = false; // In the round robin
+		LocalVector<Message> queue;
+		uint32_t head = 0; // First message not yet dispatched
+	};
+
+	static uint64_t flow_key(int fd, Lane lane) { return ((uint64_t)fd << 1) | (uint64_t)lane; }
+
+	HashMap<uint64_t, Flow> flows;
+	LocalVector<uint64_t> active; // Round robin order of non-empty flows
+	uint32_t cursor = 0;
+	HashMap<int, Peer> peers;
+	LocalVector<int> peer_fds;
+	int queued = 0;
+
+	int inbound_max_messages = 1024;
+	int64_t inbound_max_bytes = 16 << 20;
+	int64_t outbound_max_bytes = 16 << 20;
+	int inbound_high_water = 0;
+	int64_t inbound_high_water_bytes = 0;
+	int64_t outbound_high_water_bytes = 0;
+};
+
+// ClassDB introspection replies, encoded once and then served by copying the bytes
+// All classes are encoded into one snapshot image that is written under user:// and
+// memory-mapped on later starts, as long as the engine version and extensions match
+// Blobs are terms without a version byte, ready to append to a reply
+class CNodeClassMetadata {
+public:
+	enum Section {
+		SECTION_METHODS,
+		SECTION_PROPERTIES,
+		SECTION_SIGNALS,
+		SECTION_ENUMS,
+		SECTION_MAX,
+	};
+
+	struct Blob {
+		const char *data = nullptr;
+		int size = 0;
+	};
+
+	~CNodeClassMetadata();
+
+	// Hash of the engine version and the loaded extensions, stored in the snapshot header
+	static uint64_t compute_hash();
+
+	// Maps an existing snapshot; false when it is missing or was written for another hash
+	bool map_snapshot(const String &path, uint64_t hash);
+	// Encodes every class, then writes the snapshot to path (kept in memory if that fails)
+	void build_snapshot(const String &path, uint64_t hash);
+	bool is_loaded() const { return image != nullptr; }
+
+	Blob get_class_list() const;
+	Blob get_singleton_list() const;
+	// false when the class does not exist
+	bool get_class_section(const String &class_name, Section section, Blob &r_blob) const;
+
+private:
+	bool _attach(const char *data, size_t size, uint64_t hash);
+	void _release();
+
+	const char *image = nullptr;
+	size_t image_size = 0;
+	void *mapping = nullptr; // Set when image points into an mmap of the snapshot file
+	LocalVector<char> owned_image; // Set when it does not
+	HashMap<String, uint32_t> class_index; // Class name to entry
+};
+
+// Small-integer object handles for one connection ({call, godot, use_handles, [true]})
+// A handle is (generation << INDEX_BITS) | (slot + 1), so it always fits a 32-bit Erlang integer
+// and a handle whose object was freed (and slot reused) no longer resolves
+class CNodeObjectHandles {
+public:
+	static const int INDEX_BITS = 20;
+	static const uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+	static const uint32_t GENERATION_MASK = (1u << (31 - INDEX_BITS)) - 1;
+	static const int64_t MAX_HANDLE = INT32_MAX;
+
+	// Returns 0 when the table is full, callers then fall back to the ObjectID
+	uint32_t get_handle(Object *object);
+	Object *lookup(uint32_t handle) const;
+	void invalidate(ObjectID id);
+
+private:
+	struct Slot {
+		Object *object; // nullptr while free
+		uint32_t generation;
+	};
+	LocalVector<Slot> slots;
+	LocalVector<uint32_t> free_slots;
+	HashMap<uint64_t, uint32_t> slot_by_object;
+};
+
+// Stored as metadata on every object that has a handle; its destruction with the object's
+// metadata (on predelete) invalidates the handles in all tables
+class CNodeHandleSentinel : public RefCounted {
+	GDCLASS(CNodeHandleSentinel, RefCounted);
+
+protected:
+	static void _bind_methods() {}
+
+public:
+	ObjectID target;
+
+	~CNodeHandleSentinel();
+};
+
+// Properties to send along with returned objects ({object, Class, Id, #{Prop => Value}})
+// Entries are checked in order, the first class the object inherits from applies
+struct CNodePrefetchSpec {
+	LocalVector<String> classes;
+	LocalVector<LocalVector<StringName>> properties; // Parallel to classes
+};
+
+// One node of a flattened {call, godot, spawn_tree, ...} spec, in spec (pre-)order
+struct CNodeSpawnEntry {
+	String type; // ClassDB class name or PackedScene path
+	Dictionary props;
+	int parent; // Index of the parent entry, -1 = the spawn target
+};
+
+// Counters reported by {call, godot, get_stats, []}
+struct CNodeRequestStats {
+	uint64_t expired_calls = 0; // Requests dropped at dequeue because their deadline had passed
+	uint64_t expired_casts = 0;
+	uint64_t overloaded_calls = 0; // Calls answered {error, overloaded} without running
+};
+
 class CNodeServer : public Node {
 	GDCLASS(CNodeServer, Node);
 
 private:
+	static CNodeServer *singleton;
+
 	bool initialized;
 	char *cookie_copy;
 
+	// Where the network is serviced, from the network/cnode/* project settings
+	enum ProcessHook {
+		PROCESS_HOOK_IDLE,
+		PROCESS_HOOK_PHYSICS,
+		PROCESS_HOOK_BOTH,
+	};
+	struct ServiceBudget {
+		int max_messages = 64; // Per service pass
+		int64_t max_usec = 2000; // Per hook call
+	};
+	ProcessHook process_hook = PROCESS_HOOK_IDLE;
+	ServiceBudget idle_budget;
+	ServiceBudget physics_budget;
+
+	void _load_process_settings();
+	void _service_network(const ServiceBudget &budget);
+
+	// Inbound queues of all connections, see CNodePeerScheduler
+	CNodePeerScheduler scheduler;
+	Dictionary peer_weights; // Node name (or the part before '@') -> scheduling weight
+	bool split_lanes = true; // Separate call and cast lanes, otherwise one lane keeps arrival order
+
+	// Class introspection data, mapped from a snapshot at startup or built on the first introspection call
+	CNodeClassMetadata class_metadata;
+
+	// RefCounted objects from create_object, kept alive until their connection closes
+	HashMap<int, LocalVector<Variant>> created_objects;
+
+	// Scheduled casts ({cast, godot, call_at, ...}), one wheel per processing hook
+	CNodeTimerWheel physics_wheel;
+	CNodeTimerWheel idle_wheel;
+
+	void _run_due_requests(CNodeTimerWheel &wheel, uint64_t frame);
+
+	// Scene tree subscriptions ({call, godot, watch_tree, ...}), diffs are batched per frame
+	enum TreeDiffKind {
+		TREE_DIFF_ADDED,
+		TREE_DIFF_REMOVED,
+		TREE_DIFF_RENAMED,
+	};
+	struct TreeWatcher {
+		int fd;
+		erlang_pid pid;
+		ObjectID root;
+		ei_x_buff pending; // Encoded diff terms not sent yet
+		int pending_count;
+	};
+	LocalVector<TreeWatcher> tree_watchers;
+
+	void _update_tree_signals();
+	void _queue_tree_diff(TreeDiffKind kind, Node *node);
+	void _flush_tree_watchers();
+	void _on_tree_node_added(Node *node);
+	void _on_tree_node_removed(Node *node);
+	void _on_tree_node_renamed(Node *node);
+
+	// Multi-frame spawn_tree jobs, advanced by `batch` entries per frame
+	struct SpawnJob {
+		uint64_t id;
+		int fd;
+		erlang_pid pid;
+		erlang_ref tag;
+		ObjectID target;
+		LocalVector<CNodeSpawnEntry> entries;
+		LocalVector<ObjectID> ids; // Created so far, one per processed entry
+		int batch;
+	};
+	LocalVector<SpawnJob> spawn_jobs;
+	uint64_t next_job_id;
+
+	void _process_spawn_jobs();
+
+	// Multi-frame nav_path_batch jobs, advanced by `batch` queries per frame
+	struct NavPathJob {
+		uint64_t id;
+		int fd;
+		erlang_pid pid;
+		erlang_ref tag;
+		RID map;
+		PackedFloat32Array queries; // 7 words per query
+		bool optimize;
+		int batch;
+		LocalVector<uint32_t> offsets; // One end offset per finished query
+		LocalVector<float> points;
+	};
+	LocalVector<NavPathJob> nav_path_jobs;
+
+	void _process_nav_path_jobs();
+
+	// PackedScene cache and recycled instances, both keyed by res:// scene path (uid:// paths are resolved)
+	static const uint32_t SCENE_POOL_LIMIT = 1024;
+	HashMap<String, Ref<PackedScene>> scene_cache;
+	HashMap<String, LocalVector<ObjectID>> scene_pools; // Detached instances ready for reuse
+	// Instances handed out detached, by instance ID -> connection; freed with it unless attached by then
+	HashMap<uint64_t, int> detached_instances;
+
+	// Threaded resource loads ({call, godot, load_async, ...}), polled once per frame
+	struct ResourceSubscriber {
+		int fd;
+		erlang_pid pid;
+		erlang_ref tag;
+	};
+	struct ResourceLoad {
+		String path;
+		double progress; // Last progress sent
+		LocalVector<ResourceSubscriber> subscribers;
+	};
+	LocalVector<ResourceLoad> resource_loads;
+	HashMap<String, Ref<Resource>> loaded_resources; // Completed loads, held until unload
+
+	void _poll_resource_loads();
+	void _send_load_result(ResourceSubscriber &subscriber, const String &path, const Ref<Resource> &resource);
+
+	// CPU-side copies of MultiMesh buffers receiving ranged updates, keyed by MultiMesh instance ID
+	struct MultiMeshShadow {
+		PackedFloat32Array buffer;
+		bool dirty; // Needs uploading at the end of the frame
+	};
+	HashMap<uint64_t, MultiMeshShadow> multimesh_shadows;
+
+	void _flush_multimesh_updates();
+
+	// Server-side objects created without scene nodes, addressed by compact handles laid out like
+	// CNodeObjectHandles handles: (generation << INDEX_BITS) | (slot + 1), only valid on the owning connection
+	enum RidKind : uint8_t {
+		RID_KIND_FREE,
+		RID_KIND_INSTANCE, // RenderingServer instance
+		RID_KIND_BODY, // PhysicsServer3D body
+	};
+	struct RidHandle {
+		RID rid;
+		RidKind kind;
+		int fd; // Owning connection, handles are freed when it closes
+		uint32_t generation; // Bumped when the slot is freed so old handles stop resolving
+	};
+	LocalVector<RidHandle> rid_handles;
+	LocalVector<uint32_t> free_rid_handles;
+
+	uint32_t _add_rid_handle(const RID &rid, RidKind kind, int fd);
+	RidHandle *_get_rid_handle(int fd, uint32_t handle);
+	void _free_rid_slot(uint32_t slot);
+
+	// NodePath lookups per root node; an entry is dropped when its node leaves the tree, or it or an
+	// ancestor is renamed (a node moving elsewhere leaves the tree first)
+	static const int NODE_PATH_CACHE_LIMIT = 4096;
+	HashMap<uint64_t, HashMap<String, ObjectID>> node_path_cache;
+	HashMap<uint64_t, int> node_path_targets; // Cached node ID -> entries resolving to it
+	int node_path_cache_size = 0;
+
+	void _clear_node_path_cache();
+	// Drops the entries resolving to node, or to node and its descendants
+	void _drop_node_paths(Node *node, bool descendants);
+	void _on_cached_node_removed(Node *node);
+	void _on_cached_node_renamed(Node *node);
+
+	// Declared type of every property of a class, built on first use by get_properties
+	HashMap<String, HashMap<StringName, Variant::Type>> class_property_types;
+
+	// Connection-wide prefetch specs ({call, godot, set_prefetch, [Spec]})
+	HashMap<int, CNodePrefetchSpec> prefetch_specs;
+
+	// Handle tables of connections that opted into small-integer object IDs
+	HashMap<int, CNodeObjectHandles> object_handles;
+
+	CNodeRequestStats stats;
+
+	// GenServer calls answered after their handler returned, so many can be in flight per connection
+	struct PendingReply {
+		CNodeReplyTarget target;
+		uint64_t deadline_usec; // 0 = no deadline, otherwise answered {error, timeout} once passed
+	};
+	HashMap<uint64_t, PendingReply> pending_replies;
+	uint64_t next_reply_id = 1;
+
+	// {call, godot, wait_frames, ...} waiters, answered once the process frame is reached
+	struct FrameWait {
+		uint64_t reply_id;
+		uint64_t frame;
+	};
+	LocalVector<FrameWait> frame_waits;
+
+	// {call, godot, await_signal, ...} waiters by reply id, answered by the first emission of the signal
+	struct SignalWait {
+		ObjectID object;
+		StringName signal;
+		Callable callback;
+	};
+	HashMap<uint64_t, SignalWait> signal_waits;
+
+	void _expire_pending_replies();
+	void _complete_frame_waits();
+	void _on_awaited_signal(const Variant **p_args, GDExtensionInt p_argcount, GDExtensionCallError &r_error);
+	void _prune_signal_waits();
+
+	// Lockstep mode: physics only advances by ticks granted through {call, godot, step, ...}
+	struct LockstepStep {
+		int fd;
+		uint64_t reply_id; // Pending reply answered after the last tick
+		uint64_t ticks_left;
+		LocalVector<ObjectID> ids; // Objects whose fields are returned once the ticks have run
+		LocalVector<StringName> fields;
+	};
+	static constexpr int LOCKSTEP_POLL_USEC = 100;
+	bool lockstep = false;
+	int lockstep_fd = -1;
+	int32_t saved_physics_priority = 0; // Restored when lockstep ends
+	bool step_pending = false;
+	LockstepStep current_step;
+
+	void _lockstep_tick();
+	void _finish_step();
+
 protected:
 	static void _bind_methods();
 
 public:
+	static CNodeServer *get_singleton() { return singleton; }
+
 	CNodeServer();
 	~CNodeServer();
 
 	void _ready() override;
 	void _process(double delta) override;
+	void _physics_process(double delta) override;
+
+	// Queue an encoded {Module, Function, Args} cast to run on a given frame
+	void schedule_physics_request(uint64_t physics_frame, const char *term, int term_len);
+	void schedule_idle_request(uint64_t process_frame, const char *term, int term_len);
+	// Queue an encoded call to re-run on a physics frame, e.g. queries that need physics-safe time
+	void schedule_physics_call(uint64_t physics_frame, const char *term, int term_len, int fd, const erlang_pid &pid, const erlang_ref &tag);
+
+	// Returns the job ID reported in the {spawned, JobId, Ids} completion message
+	uint64_t start_spawn_job(int fd, const erlang_pid &pid, const erlang_ref &tag, Node *target, const LocalVector<CNodeSpawnEntry> &entries, int batch);
+
+	// Loads a PackedScene once and keeps it for later instancing
+	Ref<PackedScene> get_cached_scene(const String &path);
+	// Pops a pooled instance of the scene, or instantiates a new one (detached either way)
+	Node *acquire_scene_instance(const String &path);
+	// Makes fd the owner of a detached instance until it is attached, released or the connection closes
+	void track_detached_instance(int fd, Node *node);
+	// False for nodes without a scene file path and for the current scene, which release rejects
+	bool is_releasable_scene_instance(Node *node) const;
+	// Detaches a scene instance into its pool; frees it instead when the pool is full
+	bool release_scene_instance(Node *node);
+	void clear_scene_cache();
+
+	// Starts (or joins) a threaded load of path; false when ResourceLoader rejects the request
+	bool load_async(int fd, const erlang_pid &pid, const erlang_ref &tag, const String &path, const String &type_hint);
+	void unload_resource(const String &path);
+
+	// Returns the job ID reported in the {nav_paths, JobId, Binary} completion message
+	uint64_t start_nav_path_job(int fd, const erlang_pid &pid, const erlang_ref &tag, const RID &map, const PackedFloat32Array &queries, bool optimize, int batch);
+
+	// Replaces the whole instance buffer; false when its size does not match the MultiMesh
+	bool multimesh_set_buffer(MultiMesh *multimesh, const PackedFloat32Array &buffer);
+	// Patches instances starting at first_instance; uploaded once per frame by _process
+	bool multimesh_update(MultiMesh *multimesh, int64_t first_instance, const PackedFloat32Array &values);
+
+	// Bulk RenderingServer instances / PhysicsServer3D bodies; return the handle of each created RID
+	void create_rid_instances(int fd, const RID &base, const RID &scenario, int count, LocalVector<uint32_t> &r_handles);
+	void create_rid_bodies(int fd, const RID &shape, const RID &space, int mode, int count, LocalVector<uint32_t> &r_handles);
+	// Both ignore handles that are stale or owned by another connection
+	bool set_rid_transform(int fd, uint32_t handle, const Transform3D &transform);
+	bool free_rid_handle(int fd, uint32_t handle);
+
+	void count_expired_request(bool is_call) { (is_call ? stats.expired_calls : stats.expired_casts)++; }
+	void count_overloaded_call() { stats.overloaded_calls++; }
+	const CNodeRequestStats &get_stats() const { return stats; }
+
+	// Takes over the reply of the call being handled; timeout_ms <= 0 means no deadline
+	uint64_t defer_reply(int fd, const erlang_pid &pid, const erlang_ref &tag, int64_t timeout_ms);
+	// Sends reply (a term without version byte) for a deferred call; false if it timed out or its connection closed
+	bool complete_reply(uint64_t reply_id, ei_x_buff *reply);
+	void wait_frames(uint64_t reply_id, uint64_t frame);
+	// Completes reply_id with {ok, Args} on the next emission of signal
+	Error await_signal(uint64_t reply_id, Object *obj, const StringName &signal);
+
+	void set_lockstep(int fd, bool enabled);
+	bool is_lockstep() const { return lockstep; }
+	bool is_step_pending() const { return step_pending; }
+	// Grants ticks to lockstep physics; reply_id is completed after the last of them. False while a step is running
+	bool begin_step(int fd, uint64_t reply_id, uint64_t ticks, const LocalVector<ObjectID> &ids, const LocalVector<StringName> &fields);
+
+	// root->get_node_or_null(path), cached until the tree changes under it
+	Node *find_node_cached(Node *root, const String &path);
+
+	// The type a class declares for a property, NIL when only a script or _get provides it
+	const HashMap<StringName, Variant::Type> &get_class_property_types(const String &class_name);
+
+	// Maps or builds the ClassDB snapshot on first use
+	CNodeClassMetadata &get_class_metadata();
+	void keep_created_object(int fd, const Variant &object);
+
+	// An empty spec turns prefetching off; get_prefetch returns nullptr when it is off
+	void set_prefetch(int fd, const CNodePrefetchSpec &spec);
+	const CNodePrefetchSpec *get_prefetch(int fd);
+
+	void set_object_handles(int fd, bool enabled);
+	// nullptr unless the connection is in handles mode
+	CNodeObjectHandles *get_object_handles(int fd);
+	void object_freed(ObjectID id);
+
+	void watch_tree(int fd, const erlang_pid &pid, Node *root);
+	void unwatch_tree(const erlang_pid &pid);
+
+	CNodePeerScheduler &get_scheduler() { return scheduler; }
+	int get_scheduled_count() const { return physics_wheel.size() + idle_wheel.size(); }
+	int get_peer_weight(const String &node_name) const;
+	bool is_split_lanes() const { return split_lanes; }
+
+	// Cancels queued calls, deferred replies and multi-frame jobs started by the call with `tag` (if given)
+	// or with `job_id` (0 = none); returns how many were cancelled
+	int cancel_requests(const erlang_ref *tag, uint64_t job_id);
+
+	// Drop subscriptions and other state tied to a closed connection
+	void connection_closed(int fd);
 
 	// Called deferred to add node to scene tree
 	void _add_to_scene_tree();
@@ -139,6 +139,7 @@ void initialize_cnode_module(ModuleInitializationLevel p_level) {
 
 	// Register CNodeServer class
 	ClassDB::register_class<CNodeServer>();
+	GDREGISTER_INTERNAL_CLASS(CNodeHandleSentinel);
 
 	// Create CNodeServer node
 	CNodeServer *cnode_server = memnew(CNodeServer);
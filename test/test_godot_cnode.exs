@@ -37,6 +37,18 @@ defmodule TestGodotCNode do
         test_genserver_cast(cnode_name)
         Process.sleep(500)
         test_error_handling(cnode_name)
+        Process.sleep(500)
+        test_small_handles(cnode_name)
+        Process.sleep(500)
+        test_reconnect(cnode_name)
+        Process.sleep(500)
+        test_malformed_peer(cnode_name)
+        Process.sleep(500)
+        test_slow_reader(cnode_name)
+        Process.sleep(500)
+        test_expired_call(cnode_name)
+        Process.sleep(500)
+        test_cancel(cnode_name)
         IO.puts("")
         IO.puts("=== Test Complete ===")
       _ ->
@@ -171,6 +183,209 @@ defmodule TestGodotCNode do
         IO.puts("  ✗ Failed to send: #{inspect(error)}")
     end
   end
+
+  # Test ID lists of handles below 256, which Erlang encodes as byte strings
+  defp test_small_handles(cnode_name) do
+    IO.puts("")
+    IO.puts("=== Testing Small Handles ===")
+    IO.puts("")
+
+    IO.puts("1. get_properties with a handle list below 256")
+    {:ok, _} = gen_call(cnode_name, {:godot, :use_handles, [true]})
+
+    case gen_call(cnode_name, {:godot, :get_scene_tree_root, []}) do
+      {:ok, {:object, _class, handle}} when handle < 256 ->
+        case gen_call(cnode_name, {:godot, :get_properties, [[handle], ["name"]]}) do
+          {:ok, {:ok, [_column], []}} ->
+            IO.puts("  ✓ Handle #{handle} resolved in an ID list")
+          other ->
+            IO.puts("  ✗ Unexpected reply: #{inspect(other)}")
+        end
+      other ->
+        IO.puts("  ✗ Expected a handle below 256, got: #{inspect(other)}")
+    end
+
+    gen_call(cnode_name, {:godot, :use_handles, [false]})
+  end
+
+  # Send one GenServer call and wait for its reply
+  defp gen_call(cnode_name, request) do
+    ref = make_ref()
+    :erlang.send({:godot_server, cnode_name}, {:"$gen_call", {self(), ref}, request})
+
+    receive do
+      {^ref, reply} -> {:ok, reply}
+    after
+      @timeout -> {:error, :timeout}
+    end
+  end
+
+  # Test that the CNode keeps serving after a peer disconnects and a new connection arrives
+  defp test_reconnect(cnode_name) do
+    IO.puts("")
+    IO.puts("=== Testing Reconnect ===")
+    IO.puts("")
+
+    IO.puts("1. Disconnect and connect again")
+    :erlang.disconnect_node(cnode_name)
+    Process.sleep(500)
+
+    case :net_kernel.connect_node(cnode_name) do
+      true ->
+        IO.puts("  ✓ Reconnected to CNode")
+        ref = make_ref()
+        gen_call = {:"$gen_call", {self(), ref}, {:erlang, :node, []}}
+        :erlang.send({:godot_server, cnode_name}, gen_call)
+
+        receive do
+          {^ref, reply} ->
+            IO.puts("  ✓ Received reply after reconnect: #{inspect(reply)}")
+        after
+          @timeout ->
+            IO.puts("  ✗ Timeout waiting for reply after reconnect")
+        end
+      _ ->
+        IO.puts("  ✗ Failed to reconnect to CNode")
+    end
+  end
+
+  # Test that a malformed request from one connection does not stop the CNode for the others
+  defp test_malformed_peer(cnode_name) do
+    IO.puts("")
+    IO.puts("=== Testing Malformed Request On Another Connection ===")
+    IO.puts("")
+
+    IO.puts("1. Second node sends a call with a non-atom function")
+
+    {:ok, peer, peer_node} =
+      :peer.start(%{
+        name: :"godot_peer_#{System.system_time(:second)}",
+        host: ~c"127.0.0.1",
+        longnames: true,
+        args: [~c"-setcookie", String.to_charlist(@cookie)]
+      })
+
+    malformed = {:"$gen_call", {self(), make_ref()}, {:godot, 42, []}}
+    :erpc.call(peer_node, :erlang, :send, [{:godot_server, cnode_name}, malformed])
+    Process.sleep(500)
+    :peer.stop(peer)
+
+    case gen_call(cnode_name, {:erlang, :node, []}) do
+      {:ok, reply} ->
+        IO.puts("  ✓ This connection still gets replies: #{inspect(reply)}")
+      {:error, :timeout} ->
+        IO.puts("  ✗ Timeout - the malformed request stopped the CNode")
+    end
+  end
+
+  # Test that a peer that stops reading gets {error, "overloaded"} instead of stalling the CNode
+  defp test_slow_reader(cnode_name) do
+    IO.puts("")
+    IO.puts("=== Testing Slow Reader ===")
+    IO.puts("")
+
+    IO.puts("1. Second node queues large replies, then stops reading")
+    count = 1000
+
+    {:ok, peer, peer_node} =
+      :peer.start(%{
+        name: :"godot_slow_#{System.system_time(:second)}",
+        host: ~c"127.0.0.1",
+        longnames: true,
+        args: [~c"-setcookie", String.to_charlist(@cookie)]
+      })
+
+    os_pid = :erpc.call(peer_node, :os, :getpid, [])
+    sink = Node.spawn(peer_node, :timer, :sleep, [:infinity])
+
+    calls =
+      for _ <- 1..count do
+        {:"$gen_call", {sink, make_ref()}, {:godot, :get_class_methods, ["RenderingServer"]}}
+      end
+
+    # One remote call sends them all, then the whole node is stopped so nothing reads its socket
+    dests = List.duplicate({:godot_server, cnode_name}, count)
+    :erpc.call(peer_node, :lists, :zipwith, [&:erlang.send/2, dests, calls])
+    System.cmd("kill", ["-STOP", to_string(os_pid)])
+
+    case gen_call(cnode_name, {:erlang, :node, []}) do
+      {:ok, _} -> IO.puts("  ✓ Other connections are served while the peer is stopped")
+      {:error, :timeout} -> IO.puts("  ✗ Timeout - the stopped reader blocked the CNode")
+    end
+
+    Process.sleep(2000)
+    System.cmd("kill", ["-CONT", to_string(os_pid)])
+    replies = collect_sink(peer_node, sink, count, 50)
+    overloaded = Enum.count(replies, &match?({_, {:error, ~c"overloaded"}}, &1))
+
+    if overloaded > 0 do
+      IO.puts("  ✓ #{overloaded} of #{count} calls were answered {error, \"overloaded\"}")
+    else
+      IO.puts("  ✗ No call was shed (#{length(replies)} replies)")
+    end
+
+    :peer.stop(peer)
+  end
+
+  # Test that a call whose deadline has passed is answered {error, "expired"} without running
+  defp test_expired_call(cnode_name) do
+    IO.puts("")
+    IO.puts("=== Testing Request Deadlines ===")
+    IO.puts("")
+
+    IO.puts("1. Call with a deadline already in the past")
+
+    case gen_call(cnode_name, {:godot, :get_frames, [], %{deadline_ms: 1}}) do
+      {:ok, {:error, ~c"expired"}} ->
+        IO.puts("  ✓ Expired call was answered {error, \"expired\"}")
+      other ->
+        IO.puts("  ✗ Unexpected reply: #{inspect(other)}")
+    end
+
+    IO.puts("2. get_stats counts it")
+
+    case gen_call(cnode_name, {:godot, :get_stats, []}) do
+      {:ok, %{expired_calls: expired}} when expired > 0 ->
+        IO.puts("  ✓ expired_calls = #{expired}")
+      other ->
+        IO.puts("  ✗ Unexpected reply: #{inspect(other)}")
+    end
+  end
+
+  # Test that cancelling a call waiting on a deferred reply answers it right away
+  defp test_cancel(cnode_name) do
+    IO.puts("")
+    IO.puts("=== Testing Cancellation ===")
+    IO.puts("")
+
+    IO.puts("1. Cancel a long wait_frames call by its tag")
+    ref = make_ref()
+    :erlang.send({:godot_server, cnode_name}, {:"$gen_call", {self(), ref}, {:godot, :wait_frames, [1_000_000, 0]}})
+    Process.sleep(200)
+    :erlang.send({:godot_server, cnode_name}, {:"$gen_cast", {:godot, :cancel, [ref]}})
+
+    receive do
+      {^ref, {:error, ~c"cancelled"}} ->
+        IO.puts("  ✓ Call was answered {error, \"cancelled\"}")
+      {^ref, other} ->
+        IO.puts("  ✗ Unexpected reply: #{inspect(other)}")
+    after
+      @timeout ->
+        IO.puts("  ✗ Timeout - the cancel did not answer the call")
+    end
+  end
+
+  # Wait until the sink process on the peer holds `count` messages (or give up) and return them
+  defp collect_sink(peer_node, sink, count, tries) do
+    {:messages, messages} = :erpc.call(peer_node, :erlang, :process_info, [sink, :messages])
+
+    if length(messages) >= count or tries == 0 do
+      messages
+    else
+      Process.sleep(100)
+      collect_sink(peer_node, sink, count, tries - 1)
+    end
+  end
 end
 
 TestGodotCNode.run()